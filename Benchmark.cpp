@@ -0,0 +1,719 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "Config.h"
+#include "Effect.h"
+#include "ParallelGather.h"
+#include "ParticleKernels.h"
+#include "ParticlePool.h"
+#include "ParticleSystem.h"
+#include "Random.h"
+#include "SoftwareRenderer.h"
+#include "TimerWheel.h"
+#include "Utils.h"
+#include "WorkerPool.h"
+
+static constexpr uint64_t benchmarkSeed = 12345;
+static constexpr float benchmarkDt = static_cast<float>(effectSimTimeStep);
+
+static double minBenchmarkTime = 0.25;
+static const char* benchmarkFilter = nullptr;
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+// every heap allocation of the benchmark process, on any thread, goes through the operators below
+static std::atomic<uint64_t> heapAllocationsCount = 0;
+
+static void* countedAllocate(const size_t size, const size_t alignment) {
+
+	heapAllocationsCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* memory = nullptr;
+#if defined(_WIN32)
+	memory = _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+	if (posix_memalign(&memory, alignment, size > 0 ? size : 1) != 0)
+		memory = nullptr;
+#endif
+
+	if (!memory)
+		throw std::bad_alloc();
+
+	return memory;
+}
+
+static void countedFree(void* memory) {
+
+#if defined(_WIN32)
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+void* operator new(size_t size) { return countedAllocate(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size) { return countedAllocate(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t alignment) { return countedAllocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedAllocate(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void* memory) noexcept { countedFree(memory); }
+void operator delete[](void* memory) noexcept { countedFree(memory); }
+void operator delete(void* memory, size_t) noexcept { countedFree(memory); }
+void operator delete[](void* memory, size_t) noexcept { countedFree(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { countedFree(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { countedFree(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { countedFree(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { countedFree(memory); }
+
+static double secondsSince(const BenchmarkClock::time_point& start) {
+	return std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+}
+
+static bool isSelected(const char* name) {
+	return !benchmarkFilter || strstr(name, benchmarkFilter) != nullptr;
+}
+
+static void report(const char* name, const char* unit, const uint64_t items, const double seconds) {
+
+	const double nsPerItem = seconds * 1e9 / static_cast<double>(items);
+	const double itemsPerSec = static_cast<double>(items) / seconds;
+	printf("%-44s %10.3f ns/%-9s %14.0f %s/s\n", name, nsPerItem, unit, itemsPerSec, unit);
+}
+
+// calls body(iterations) with growing batches until minBenchmarkTime is spent inside it,
+// body returns the number of items processed and the seconds spent on the timed part
+template<typename F>
+static void run(const char* name, const char* unit, F&& body) {
+
+	if (!isSelected(name))
+		return;
+
+	uint64_t items = 0;
+	double seconds = 0.0;
+	uint64_t batch = 1;
+
+	body(1, items, seconds);
+	items = 0;
+	seconds = 0.0;
+
+	while (seconds < minBenchmarkTime) {
+		body(batch, items, seconds);
+		if (batch < (1u << 20))
+			batch *= 2;
+	}
+
+	report(name, unit, items, seconds);
+}
+
+static void fillRandomPool(ParticlePool& pool, const unsigned count, const uint64_t seed) {
+
+	Random random(seed);
+
+	while (pool.GetCount() > 0)
+		pool.Remove(pool.GetCount() - 1);
+
+	const unsigned first = pool.Add(count);
+	random.FillMinMax(pool._x + first, count, -0.1f, 1.1f);
+	random.FillMinMax(pool._y + first, count, -0.1f, 1.1f);
+	random.FillMinMax(pool._vx + first, count, -0.15f, 0.15f);
+	random.FillMinMax(pool._vy + first, count, -0.15f, 0.15f);
+	random.FillMinMax(pool._age + first, count, 0.f, 2.f);
+	random.FillMinMax(pool._maxAge + first, count, 1.f, 3.f);
+
+	for (unsigned i = first; i < first + count; ++i)
+		pool._flags[i] = static_cast<uint8_t>(ParticleFlagAlive | (random.Next01() < particleExplodeProbability ? ParticleFlagCanExplode : 0));
+}
+
+// particles that stay alive and in bounds forever, so a benchmark keeps a constant live count
+static void fillSteadyPool(ParticlePool& pool, const unsigned count) {
+
+	while (pool.GetCount() > 0)
+		pool.Remove(pool.GetCount() - 1);
+
+	const unsigned first = pool.Add(count);
+	for (unsigned i = first; i < first + count; ++i) {
+		pool._x[i] = 0.5f;
+		pool._y[i] = 0.5f;
+		pool._vx[i] = 0.f;
+		pool._vy[i] = 0.f;
+		pool._age[i] = 0.f;
+		pool._maxAge[i] = 1e30f;
+		pool._flags[i] = ParticleFlagAlive;
+	}
+}
+
+class Benchmark
+{
+public:
+	// runs the whole simulation on its own threads while this thread renders software frames of it, which gathers every
+	// effect through ParallelGather, and fails if the heap is touched once both have warmed up. A run whose effects die
+	// out, that ticks no more or renders nothing while measuring tests nothing, it is retried with the next seed
+	static bool verifySteadyStateAllocations() {
+
+		constexpr double timeScale = 4.0;
+		constexpr auto warmUpTime = std::chrono::milliseconds(1000);
+		constexpr auto measureTime = std::chrono::milliseconds(1000);
+		constexpr auto frameInterval = std::chrono::milliseconds(15);
+		constexpr unsigned attemptsCount = 4;
+
+		for (unsigned attempt = 0; attempt < attemptsCount; ++attempt) {
+
+			const uint64_t seed = benchmarkSeed + attempt;
+			SetRandomSeed(seed);
+
+			ParticleSystem system(2);
+			system.SetTimeScale(timeScale);
+
+			SoftwareRenderer renderer(sceneWidth, sceneHeight, 2);
+
+			const auto renderFor = [&system, &renderer, frameInterval](const std::chrono::milliseconds duration) {
+				const auto end = BenchmarkClock::now() + duration;
+				while (BenchmarkClock::now() < end) {
+					renderer.Render(system.GetEffects());
+					std::this_thread::sleep_for(frameInterval);
+				}
+			};
+
+			system.Start();
+
+			renderFor(warmUpTime);
+
+			const uint64_t allocationsBefore = heapAllocationsCount.load();
+			const uint64_t ticksBefore = system.GetScheduler().GetTicksCount();
+			const uint64_t framesBefore = renderer.GetFramesCount();
+
+			renderFor(measureTime);
+
+			const uint64_t allocations = heapAllocationsCount.load() - allocationsBefore;
+			const uint64_t ticks = system.GetScheduler().GetTicksCount() - ticksBefore;
+			const uint64_t frames = renderer.GetFramesCount() - framesBefore;
+			const bool diedOut = system.IsStopRequested();
+
+			system.Stop();
+
+			printf("steady state: %llu heap allocations over %llu effect ticks and %llu software frames, seed %llu%s\n",
+				static_cast<unsigned long long>(allocations), static_cast<unsigned long long>(ticks),
+				static_cast<unsigned long long>(frames), static_cast<unsigned long long>(seed),
+				diedOut ? ", effects died out early" : "");
+
+			if (allocations > 0) {
+				printf("ERROR: the simulation or the renderer allocates after warm-up\n");
+				return false;
+			}
+
+			if (!diedOut && ticks > 0 && frames > 0)
+				return true;
+		}
+
+		printf("ERROR: no run kept its effects alive long enough to measure\n");
+		return false;
+	}
+
+	static bool verifyKernels() {
+
+		constexpr unsigned count = maxParticlesPerEffectCount - 3;
+		constexpr unsigned ticks = 200;
+		constexpr unsigned wordsCount = (maxParticlesPerEffectCount + 63) / 64;
+
+		ParticlePool reference;
+		reference.Resize(maxParticlesPerEffectCount);
+
+		bool allIdentical = true;
+
+		for (uint64_t seed = benchmarkSeed; seed < benchmarkSeed + 8; ++seed) {
+
+			// odd seeds check the kernels built without the lifetime check
+			const bool checkLifetime = seed % 2 == 0;
+			fillRandomPool(reference, count, seed);
+
+			ParticlePool pools[4];
+			uint64_t killMasks[4][wordsCount] = {};
+			uint64_t explodeMasks[4][wordsCount] = {};
+
+			for (unsigned isaInd = 0; isaInd < 4; ++isaInd) {
+
+				const auto kernel = GetParticleKernel(static_cast<ParticleKernelIsa>(isaInd), checkLifetime);
+				if (!kernel)
+					continue;
+
+				auto& pool = pools[isaInd];
+				pool.Resize(maxParticlesPerEffectCount);
+				pool.CopyFrom(reference);
+
+				uint64_t killAccum[wordsCount] = {};
+				uint64_t explodeAccum[wordsCount] = {};
+
+				for (unsigned tick = 0; tick < ticks; ++tick) {
+					kernel(pool, count, benchmarkDt, killMasks[isaInd], explodeMasks[isaInd]);
+					for (unsigned w = 0; w < wordsCount; ++w) {
+						// fold every tick in, so a difference on any tick shows up
+						killAccum[w] = killAccum[w] * 31 + killMasks[isaInd][w];
+						explodeAccum[w] = explodeAccum[w] * 31 + explodeMasks[isaInd][w];
+					}
+				}
+
+				std::memcpy(killMasks[isaInd], killAccum, sizeof(killAccum));
+				std::memcpy(explodeMasks[isaInd], explodeAccum, sizeof(explodeAccum));
+
+				if (isaInd == 0)
+					continue;
+
+				const bool identical =
+					std::memcmp(killMasks[isaInd], killMasks[0], sizeof(killAccum)) == 0 &&
+					std::memcmp(explodeMasks[isaInd], explodeMasks[0], sizeof(explodeAccum)) == 0 &&
+					std::memcmp(pool._x, pools[0]._x, count * sizeof(float)) == 0 &&
+					std::memcmp(pool._y, pools[0]._y, count * sizeof(float)) == 0 &&
+					std::memcmp(pool._age, pools[0]._age, count * sizeof(float)) == 0;
+
+				if (!identical) {
+					fprintf(stderr, "ERROR: %s kernel differs from scalar for seed %llu\n",
+						GetParticleKernelIsaName(static_cast<ParticleKernelIsa>(isaInd)), static_cast<unsigned long long>(seed));
+					allIdentical = false;
+				}
+			}
+		}
+
+		printf("kernels: best %s, simd paths %s scalar on fixed seeds\n",
+			GetParticleKernelIsaName(GetBestParticleKernelIsa()), allIdentical ? "bit-identical to" : "DIFFER from");
+		return allIdentical;
+	}
+
+	static void rng() {
+
+		run("rng/rnd01", "call", [](uint64_t iterations, uint64_t& items, double& seconds) {
+			volatile float sink = 0.f;
+			const auto start = BenchmarkClock::now();
+			for (uint64_t i = 0; i < iterations; ++i)
+				sink = sink + rnd01();
+			seconds += secondsSince(start);
+			items += iterations;
+		});
+
+		run("rng/rndfMinMax", "call", [](uint64_t iterations, uint64_t& items, double& seconds) {
+			volatile float sink = 0.f;
+			const auto start = BenchmarkClock::now();
+			for (uint64_t i = 0; i < iterations; ++i)
+				sink = sink + rndfMinMax(particleMinSpeed, particleMaxSpeed);
+			seconds += secondsSince(start);
+			items += iterations;
+		});
+
+		run("rng/Random::Fill01 x512", "float", [](uint64_t iterations, uint64_t& items, double& seconds) {
+			static Random random(benchmarkSeed);
+			static float values[maxParticlesPerEffectCount];
+			const auto start = BenchmarkClock::now();
+			for (uint64_t i = 0; i < iterations; ++i)
+				random.Fill01(values, maxParticlesPerEffectCount);
+			seconds += secondsSince(start);
+			items += iterations * maxParticlesPerEffectCount;
+		});
+	}
+
+	static void particleUpdate() {
+
+		run("Particle::Update x512", "particle", [](uint64_t iterations, uint64_t& items, double& seconds) {
+			static ParticlePool pool;
+			if (pool.GetCapacity() == 0) {
+				pool.Resize(maxParticlesPerEffectCount);
+				fillSteadyPool(pool, maxParticlesPerEffectCount);
+			}
+
+			const auto start = BenchmarkClock::now();
+			for (uint64_t i = 0; i < iterations; ++i)
+				for (unsigned index = 0; index < pool.GetCount(); ++index)
+					pool[index].Update(benchmarkDt);
+			seconds += secondsSince(start);
+			items += iterations * pool.GetCount();
+		});
+	}
+
+	static void kernels() {
+
+		for (unsigned isaInd = 0; isaInd < 4; ++isaInd) {
+
+			const auto isa = static_cast<ParticleKernelIsa>(isaInd);
+			const auto kernel = GetParticleKernel(isa);
+			if (!kernel)
+				continue;
+
+			char name[64];
+			snprintf(name, sizeof(name), "StepParticles/%s x512", GetParticleKernelIsaName(isa));
+
+			run(name, "particle", [kernel](uint64_t iterations, uint64_t& items, double& seconds) {
+				static ParticlePool pool;
+				static uint64_t killMask[(maxParticlesPerEffectCount + 63) / 64];
+				static uint64_t explodeMask[(maxParticlesPerEffectCount + 63) / 64];
+				if (pool.GetCapacity() == 0)
+					pool.Resize(maxParticlesPerEffectCount);
+
+				fillSteadyPool(pool, maxParticlesPerEffectCount);
+
+				const auto start = BenchmarkClock::now();
+				for (uint64_t i = 0; i < iterations; ++i)
+					kernel(pool, pool.GetCount(), benchmarkDt, killMask, explodeMask);
+				seconds += secondsSince(start);
+				items += iterations * pool.GetCount();
+			});
+		}
+	}
+
+	static void effectUpdate() {
+
+		for (const unsigned liveCount : {16u, 64u, 256u, maxParticlesPerEffectCount}) {
+
+			char name[64];
+			snprintf(name, sizeof(name), "Effect::update live %u", liveCount);
+
+			run(name, "particle", [liveCount](uint64_t iterations, uint64_t& items, double& seconds) {
+				Effect effect;
+				effect.Start(Vec2F(0.5f, 0.5f), benchmarkSeed, maxParticlesPerEffectCount);
+				effect.spawnParticles();
+				fillSteadyPool(effect._particles, liveCount);
+
+				uint64_t tick = 0;
+				const auto start = BenchmarkClock::now();
+				for (uint64_t i = 0; i < iterations; ++i)
+					effect.update(benchmarkDt, ++tick);
+				seconds += secondsSince(start);
+				items += iterations * liveCount;
+			});
+		}
+
+		for (const auto motionMode : {ParticleMotionMode::Integrated, ParticleMotionMode::IntegratedTimerWheel, ParticleMotionMode::EventDriven}) {
+
+			const char* name = "Effect::update cascade to death";
+			if (motionMode == ParticleMotionMode::IntegratedTimerWheel)
+				name = "Effect::update cascade to death, wheel";
+			else if (motionMode == ParticleMotionMode::EventDriven)
+				name = "Effect::update cascade to death, events";
+
+			// counted in live particles per tick for both modes, so the numbers compare directly
+			run(name, "particle", [motionMode](uint64_t iterations, uint64_t& items, double& seconds) {
+				Effect effect;
+				for (uint64_t i = 0; i < iterations; ++i) {
+					effect.Start(Vec2F(0.5f, 0.5f), benchmarkSeed + i, Random(benchmarkSeed + i).NextMinMax(1, maxParticlesPerEffectCount), motionMode);
+
+					uint64_t tick = 0;
+					const auto start = BenchmarkClock::now();
+					while (effect.IsAlive()) {
+						items += effect.getLiveCount();
+						effect.update(benchmarkDt, ++tick);
+						effect.ConsumeExploded([](const ExplosionEvent&) {});
+					}
+					seconds += secondsSince(start);
+
+					effect.unschedule();
+				}
+			});
+		}
+	}
+
+	// far more particles than one effect holds, expired particles respawn in place so the live count stays put
+	static void largePoolLifetime() {
+
+		constexpr unsigned particlesCount = 1 << 17;
+
+		for (const bool useWheel : {false, true}) {
+
+			const char* name = useWheel ? "lifetime via TimerWheel x131072" : "lifetime via kernel check x131072";
+
+			run(name, "particle", [useWheel](uint64_t iterations, uint64_t& items, double& seconds) {
+				static ParticlePool pool;
+				static TimerWheel wheel;
+				static std::vector<uint64_t> killMask(particleMaskWordsCount(particlesCount));
+				static std::vector<uint64_t> explodeMask(particleMaskWordsCount(particlesCount));
+
+				Random random(benchmarkSeed);
+
+				if (pool.GetCapacity() == 0) {
+					pool.Resize(particlesCount);
+					wheel.Resize(particlesCount);
+				}
+
+				fillSteadyPool(pool, particlesCount);
+				random.FillMinMax(pool._maxAge, particlesCount, static_cast<float>(particleMinLifetime), static_cast<float>(particleMaxLifetime));
+				random.Fill01(pool._age, particlesCount);
+
+				uint64_t tick = 0;
+				wheel.Clear(tick + 1);
+
+				const auto ticksLeft = [](const float age, const float maxAge) {
+					return static_cast<uint64_t>(std::ceil((maxAge - age) / benchmarkDt));
+				};
+
+				for (unsigned i = 0; i < particlesCount; ++i) {
+					pool._age[i] *= pool._maxAge[i];
+					if (useWheel)
+						wheel.Schedule(i, tick + ticksLeft(pool._age[i], pool._maxAge[i]));
+				}
+
+				volatile unsigned sink = 0;
+
+				const auto start = BenchmarkClock::now();
+				for (uint64_t i = 0; i < iterations; ++i) {
+
+					++tick;
+					StepParticles(pool, particlesCount, benchmarkDt, killMask.data(), explodeMask.data(), !useWheel);
+
+					if (useWheel) {
+						wheel.Advance([](const unsigned index) {
+							killMask[index >> 6] |= uint64_t(1) << (index & 63);
+						});
+					}
+
+					unsigned expired = 0;
+					for (unsigned word = 0; word < killMask.size(); ++word) {
+						for (uint64_t bits = killMask[word]; bits != 0; bits &= bits - 1) {
+
+							const unsigned index = word * 64 + lowestSetBit(bits);
+							pool._age[index] = 0.f;
+							++expired;
+
+							if (useWheel)
+								wheel.Schedule(index, tick + ticksLeft(0.f, pool._maxAge[index]));
+						}
+					}
+					sink = sink + expired;
+				}
+				seconds += secondsSince(start);
+				items += iterations * particlesCount;
+			});
+		}
+	}
+
+	static void effectSnapshots() {
+
+		for (const unsigned liveCount : {16u, 64u, 256u, maxParticlesPerEffectCount}) {
+
+			char name[64];
+			snprintf(name, sizeof(name), "Effect publish+GetParticles live %u", liveCount);
+
+			run(name, "particle", [liveCount](uint64_t iterations, uint64_t& items, double& seconds) {
+				Effect effect;
+				effect.Start(Vec2F(0.5f, 0.5f), benchmarkSeed, maxParticlesPerEffectCount);
+				effect.spawnParticles();
+				fillSteadyPool(effect._particles, liveCount);
+
+				volatile unsigned sink = 0;
+				const auto start = BenchmarkClock::now();
+				for (uint64_t i = 0; i < iterations; ++i) {
+					effect.RequestSwapParticleBuffer();
+					effect.publishParticles();
+					sink = sink + effect.GetParticles().GetCount();
+				}
+				seconds += secondsSince(start);
+				items += iterations * liveCount;
+			});
+		}
+	}
+
+	static void effectExploded() {
+
+		run("Effect::ConsumeExploded x128", "event", [](uint64_t iterations, uint64_t& items, double& seconds) {
+			static Effect effect;
+			constexpr unsigned eventsCount = 128;
+
+			volatile float sink = 0.f;
+			for (uint64_t i = 0; i < iterations; ++i) {
+
+				for (unsigned e = 0; e < eventsCount; ++e) {
+					ExplosionEvent event;
+					event._position = Vec2F(0.5f, 0.5f);
+					event._tick = e;
+					effect._exploded.Push(event);
+				}
+
+				const auto start = BenchmarkClock::now();
+				effect.ConsumeExploded([&sink](const ExplosionEvent& event) {
+					sink = sink + event._position._x;
+				});
+				seconds += secondsSince(start);
+			}
+			items += iterations * eventsCount;
+		});
+	}
+
+	static void particleSystemUpdate() {
+
+		for (const unsigned effectsCount : {16u, 64u, maxEffectsCount}) {
+
+			char name[64];
+			snprintf(name, sizeof(name), "ParticleSystem::update %u effects", effectsCount);
+
+			run(name, "effect", [effectsCount](uint64_t iterations, uint64_t& items, double& seconds) {
+				ParticleSystem system(1);
+				system._random.Seed(benchmarkSeed);
+
+				// every slot is taken up front, so explosions are queued and admitted without adding effects
+				Effect* effects[maxEffectsCount] = {};
+				for (unsigned i = 0; i < maxEffectsCount; ++i)
+					effects[i] = system.aquireUnusedEffect();
+
+				for (unsigned i = 0; i < effectsCount; ++i)
+					system.startEffect(effects[i], Vec2F(0.5f, 0.5f), system._random.NextMinMax(1, maxParticlesPerEffectCount));
+
+				uint64_t tick = 0;
+				for (uint64_t i = 0; i < iterations; ++i) {
+
+					// effects are stepped outside of the timed part, their explosions feed update. The scheduler
+					// never runs here, so a dead effect is retired and restarted in place to keep effectsCount live
+					++tick;
+					for (unsigned e = 0; e < effectsCount; ++e) {
+						Effect* effect = effects[e];
+						if (!effect->IsAlive() && effect->unschedule())
+							effect->Start(Vec2F(0.5f, 0.5f), system._random.Next(), system._random.NextMinMax(1, maxParticlesPerEffectCount));
+						effect->step(benchmarkDt, tick);
+					}
+
+					const auto start = BenchmarkClock::now();
+					system.update();
+					seconds += secondsSince(start);
+				}
+				items += iterations * effectsCount;
+			});
+		}
+	}
+
+	// every effect live with a full snapshot, as many as the renderer ever sees, spread on a grid over the scene
+	static std::vector<Effect> makeRenderEffects() {
+
+		constexpr unsigned gridSize = 16;
+
+		std::vector<Effect> effects;
+		effects.reserve(maxEffectsCount);
+		for (unsigned i = 0; i < maxEffectsCount; ++i) {
+			const Vec2F position((i % gridSize + 0.5f) / gridSize, (i / gridSize % gridSize + 0.5f) / gridSize);
+			effects.emplace_back();
+			effects[i].Start(position, benchmarkSeed + i, maxParticlesPerEffectCount);
+			effects[i].spawnParticles();
+		}
+		return effects;
+	}
+
+	static void renderGather() {
+
+		const std::vector<Effect> effects = makeRenderEffects();
+
+		constexpr unsigned maxInstances = maxEffectsCount * maxParticlesPerEffectCount;
+		std::vector<float> instances(size_t(maxInstances) * ParallelGather::instanceFloatsCount);
+
+		for (const unsigned workersCount : {1u, std::max(std::thread::hardware_concurrency(), 2u)}) {
+
+			char name[64];
+			snprintf(name, sizeof(name), "ParallelGather x%u effects, %u workers", maxEffectsCount, workersCount);
+
+			WorkerPool workers(workersCount, "render gather");
+			ParallelGather gather(workers);
+			run(name, "particle", [&](uint64_t iterations, uint64_t& items, double& seconds) {
+				const auto start = BenchmarkClock::now();
+				for (uint64_t i = 0; i < iterations; ++i)
+					items += gather.Gather(effects, instances.data(), maxInstances);
+				seconds += secondsSince(start);
+			});
+		}
+	}
+
+	// whole frames of freshly exploded effects, heavy overdraw around every effect
+	static void softwareRender() {
+
+		const std::vector<Effect> effects = makeRenderEffects();
+
+		const unsigned maxWorkersCount = std::max(std::thread::hardware_concurrency(), 2u);
+		const int sizes[][2] = {{sceneWidth, sceneHeight}, {3840, 2160}};
+
+		for (const auto& size : sizes) {
+			for (const unsigned workersCount : {1u, maxWorkersCount}) {
+
+				char name[64];
+				snprintf(name, sizeof(name), "SoftwareRenderer %dx%d, %u workers", size[0], size[1], workersCount);
+
+				SoftwareRenderer renderer(size[0], size[1], workersCount);
+				run(name, "frame", [&](uint64_t iterations, uint64_t& items, double& seconds) {
+					const auto start = BenchmarkClock::now();
+					for (uint64_t i = 0; i < iterations; ++i)
+						renderer.Render(effects);
+					seconds += secondsSince(start);
+					items += iterations;
+				});
+			}
+		}
+	}
+
+	static void effectSlots() {
+
+		run("ParticleSystem::aquireUnusedEffect+release", "effect", [](uint64_t iterations, uint64_t& items, double& seconds) {
+			static ParticleSystem system(1);
+			static Effect* acquired[maxEffectsCount];
+
+			const auto start = BenchmarkClock::now();
+			for (uint64_t i = 0; i < iterations; ++i) {
+				unsigned count = 0;
+				while (Effect* effect = system.aquireUnusedEffect())
+					acquired[count++] = effect;
+				for (unsigned j = 0; j < count; ++j)
+					system._unusedEffects.Release(acquired[j]->_num);
+			}
+			seconds += secondsSince(start);
+			items += iterations * maxEffectsCount;
+		});
+	}
+};
+
+int main(int argc, char** argv)
+{
+	const char* verifyOnly = nullptr;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+			minBenchmarkTime = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+			benchmarkFilter = argv[++i];
+		}
+		else if (strcmp(argv[i], "--verify") == 0 && i + 1 < argc) {
+			verifyOnly = argv[++i];
+		}
+		else {
+			printf("usage: %s [--filter substring] [--min-time seconds] [--verify kernels|allocations]\n", argv[0]);
+			printf("  --verify  run only the given correctness check and skip the timings\n");
+			return 1;
+		}
+	}
+
+	SetRandomSeed(benchmarkSeed);
+
+	if (verifyOnly) {
+		if (strcmp(verifyOnly, "kernels") == 0)
+			return Benchmark::verifyKernels() ? 0 : 1;
+		if (strcmp(verifyOnly, "allocations") == 0)
+			return Benchmark::verifySteadyStateAllocations() ? 0 : 1;
+
+		fprintf(stderr, "ERROR: unknown check %s\n", verifyOnly);
+		return 1;
+	}
+
+	const bool kernelsIdentical = Benchmark::verifyKernels();
+	const bool steadyStateAllocationFree = Benchmark::verifySteadyStateAllocations();
+	SetRandomSeed(benchmarkSeed);
+
+	Benchmark::rng();
+	Benchmark::particleUpdate();
+	Benchmark::kernels();
+	Benchmark::effectUpdate();
+	Benchmark::largePoolLifetime();
+	Benchmark::effectSnapshots();
+	Benchmark::effectExploded();
+	Benchmark::particleSystemUpdate();
+	Benchmark::renderGather();
+	Benchmark::softwareRender();
+	Benchmark::effectSlots();
+
+	return kernelsIdentical && steadyStateAllocationFree ? 0 : 1;
+}
@@ -15,8 +15,19 @@ static constexpr unsigned int maxEffectsCount = 128;
 static constexpr double particleSystemTimeStep = 0.03;
 
 static constexpr unsigned int maxParticlesPerEffectCount = 512;
+
+// particles all running effects may hold together, and the fewest a shrunk effect starts with. The default is every
+// effect slot at full size, so the budget only changes behaviour once this is lowered
+static constexpr unsigned int maxParticlesCount = maxEffectsCount * maxParticlesPerEffectCount;
+static constexpr unsigned int minParticlesPerEffectCount = 16;
+
+// explosions waiting for an effect slot or particle budget, carried over to later particle system steps
+static constexpr unsigned int maxPendingExplosionsCount = 1024;
 static constexpr double effectSimTimeStep = 0.02;
 
+// ask the OS for transparent huge pages behind the particle arena
+static constexpr bool particleArenaHugePages = true;
+
 static constexpr float particleSystemTimeScale = 1.f;
 static constexpr float effectSimTimeScale = 1.f;
 
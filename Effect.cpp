@@ -1,8 +1,15 @@
 #include "Effect.h"
-#include "Utils.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <new>
+#include <vector>
 
 #include "Config.h"
+#include "ParticleBlockPool.h"
+#include "ParticleKernels.h"
+#include "Profiler.h"
+#include "Random.h"
 
 Effect::Effect(const Effect& other) {
 
@@ -14,236 +21,495 @@ Effect::~Effect() {
 
 	if (_isAlive)
 		deactivate();
-	
-	DetachThread();
+
+	if (_ownedStorage)
+		::operator delete(_ownedStorage, std::align_val_t(ParticlePool::alignment));
 }
 
-const std::vector<Particle>& Effect::getParticlesToRead() const {
+static_assert(maxParticlesPerEffectCount <= ParticleBlockPool::classCapacities[ParticleBlockPool::classesCount - 1],
+	"maxParticlesPerEffectCount does not fit the largest particle block class");
 
-	return _particles[1 - _particleBufferInd];
+static size_t alignedStorageSize(const size_t size) {
+	return (size + ParticlePool::alignment - 1) / ParticlePool::alignment * ParticlePool::alignment;
 }
 
-std::vector<Particle>& Effect::getParticlesToWrite()
-{
-	return _particles[_particleBufferInd];
+size_t Effect::GetStorageSize(const unsigned capacity) {
+
+	return 4 * ParticlePool::GetStorageSize(capacity)
+		+ alignedStorageSize(SpscRing<ExplosionEvent>::GetStorageSize(capacity))
+		+ alignedStorageSize(TimerWheel::GetStorageSize(capacity))
+		+ alignedStorageSize(capacity * sizeof(uint64_t));
 }
 
-Effect::Effect() {
-	
-	_particles[0].resize(maxParticlesPerEffectCount);
-	_particles[1].resize(maxParticlesPerEffectCount);
+Effect::Effect(ParticleBlockPool* blockPool) : _blockPool(blockPool) {
+
+	if (_blockPool)
+		return;
+
+	_ownedStorage = ::operator new(GetStorageSize(maxParticlesPerEffectCount), std::align_val_t(ParticlePool::alignment));
+	attachStorage(_ownedStorage, maxParticlesPerEffectCount);
 }
 
-void initParticle(Particle& p, const Vec2F& pos) {
+void Effect::attachStorage(void* storage, const unsigned capacity) {
+
+	auto* cursor = static_cast<uint8_t*>(storage);
+	const auto take = [&cursor, storage](const size_t size) {
+		void* part = storage ? cursor : nullptr;
+		cursor += alignedStorageSize(size);
+		return part;
+	};
 
-	//printf("effect initParticle at %f %f \n", pos._x, pos._y);
+	_particles.Attach(take(ParticlePool::GetStorageSize(capacity)), capacity);
+	_snapshots.ForEachBuffer([&take, capacity](ParticlePool& snapshot) {
+		snapshot.Attach(take(ParticlePool::GetStorageSize(capacity)), capacity);
+	});
 
-	p.SetPosition(pos);
+	_exploded.Attach(take(SpscRing<ExplosionEvent>::GetStorageSize(capacity)), capacity);
+	_expiryWheel.Attach(take(TimerWheel::GetStorageSize(capacity)), capacity);
+	_deathEvents = static_cast<uint64_t*>(take(capacity * sizeof(uint64_t)));
+}
+
+bool Effect::acquireStorage(const unsigned count) {
 
-	const Vec2F speedVec(rnd01() - 0.5f, rnd01() - 0.5f);
-	const float speed = rndfMinMax(particleMinSpeed, particleMaxSpeed);
-	p.SetSpeed(speedVec, speed);
+	assert(!_block);
 
-	const float r = rnd01();
-	const float g = rnd01();
-	const float b = rnd01();
-	p.SetColor(r, g, b);
+	const unsigned capacity = ParticleBlockPool::GetClassCapacity(count);
+	void* block = _blockPool->Acquire(capacity);
+	if (!block)
+		return false;
 
-	p.Activate();
+	_block = block;
+	_blockCapacity = capacity;
+
+	attachStorage(block, capacity);
+	return true;
 }
 
-std::set<Vec2F> Effect::GetExploded() {
+void Effect::releaseStorage() {
 
-	std::set<Vec2F> readExplodeSet;
-	
-	if (_swapExplodesRequested)
-		return readExplodeSet;
-	
-	readExplodeSet = _exploded[1 - _explodeInd];
-	_swapExplodesRequested = true;
-	return readExplodeSet;
+	if (!_block)
+		return;
+
+	// the explosion ring stays on the released block, ParticleSystem::update may still be reading its indices. It is
+	// empty and nothing pushes to it any more, the next Start re-attaches it from update's own thread
+	_particles.Attach(nullptr, 0);
+	_snapshots.ForEachBuffer([](ParticlePool& snapshot) {
+		snapshot.Attach(nullptr, 0);
+	});
+	_expiryWheel.Attach(nullptr, 0);
+	_deathEvents = nullptr;
+
+	_blockPool->Release(_block, _blockCapacity);
+	_block = nullptr;
+	_blockCapacity = 0;
 }
 
-void Effect::checkParticleLife(Particle& p, const unsigned index) {
+static void initParticles(ParticlePool& particles, const unsigned count, const Vec2F& pos, Random& random) {
 
-	const auto& pos = p.GetPosition();
-	const bool outOfBounds =
-		pos._x > 1.f ||
-		pos._y > 1.f ||
-		pos._x < 0.f ||
-		pos._y < 0.f;
+	//printf("effect initParticles at %f %f \n", pos._x, pos._y);
 
-	if (outOfBounds) {
-		//printf("effect %i, particle %i deactivated due to position \n", _num, index);
-		p.Deactivate();
-		return;
+	thread_local std::vector<float> scratch(2 * maxParticlesPerEffectCount);
+	float* speeds = scratch.data();
+	float* explodeRolls = speeds + count;
+
+	const unsigned first = particles.Add(count);
+
+	// one batched draw per attribute, colors and lifetimes land straight in the pool arrays
+	random.Fill01(particles._vx + first, count);
+	random.Fill01(particles._vy + first, count);
+	random.FillMinMax(speeds, count, particleMinSpeed, particleMaxSpeed);
+	random.Fill01(particles._r + first, count);
+	random.Fill01(particles._g + first, count);
+	random.Fill01(particles._b + first, count);
+	random.Fill01(explodeRolls, count);
+	random.FillMinMax(particles._maxAge + first, count, static_cast<float>(particleMinLifetime), static_cast<float>(particleMaxLifetime));
+
+	for (unsigned i = 0; i < count; ++i) {
+
+		const unsigned index = first + i;
+
+		particles._x[index] = pos._x;
+		particles._y[index] = pos._y;
+		particles._vx[index] = (particles._vx[index] - 0.5f) * speeds[i];
+		particles._vy[index] = (particles._vy[index] - 0.5f) * speeds[i];
+		particles._age[index] = 0.f;
+
+		const bool canExplode = explodeRolls[i] < particleExplodeProbability;
+		particles._flags[index] = canExplode ? (ParticleFlagAlive | ParticleFlagCanExplode) : ParticleFlagAlive;
 	}
+}
+
+void Effect::retireParticles(ParticlePool& particles, const unsigned count, const uint64_t tick) {
+
+	const bool useWheel = _motionMode == ParticleMotionMode::IntegratedTimerWheel;
+
+	// walk dead particles from the back, so the live particle moved into each hole has already been checked
+	for (unsigned wordInd = particleMaskWordsCount(count); wordInd-- > 0;) {
+
+		uint64_t killBits = _killMask[wordInd];
+		const uint64_t explodeBits = _explodeMask[wordInd];
+
+		while (killBits != 0) {
+
+			const unsigned bitInd = highestSetBit(killBits);
+			killBits &= ~(uint64_t(1) << bitInd);
+
+			const unsigned index = wordInd * 64 + bitInd;
+
+			if (explodeBits & (uint64_t(1) << bitInd)) {
+				//printf("effect %i, particle %i added to explosion list and deactivated \n", _num, index);
+				ExplosionEvent event;
+				event._position = particles[index].GetPosition();
+				event._effect = _num;
+				event._tick = tick;
 
-	const bool dieOrExplodeTime = !p.GetIsWithinLifetime();
-	if (dieOrExplodeTime)
-	{
-		if (p.GetCanExplode()) {
-			//printf("effect %i, particle %i added to explosion list and deactivated \n", _num, index);
-			_exploded[_explodeInd].insert(pos);
+				// ring holds as many events as the effect has particles, so it can never overflow
+				const bool pushed = _exploded.Push(event);
+				assert(pushed);
+				(void)pushed;
+			}
+
+			if (useWheel) {
+				// particles leaving the square still have their expiry filed, the last one takes over the freed slot
+				_expiryWheel.Cancel(index);
+				_expiryWheel.Move(particles.GetCount() - 1, index);
+			}
+
+			particles.Remove(index);
 		}
-		else 
-		{
-			//printf("effect %i, particle %i deactivated\n", _num, index);
+	}
+}
+
+// first step after which pos + velocity * step * dt has left [0, 1], matching the bounds check of the kernels
+static uint32_t exitStep(const float pos, const float velocity, const double dt) {
+
+	double steps = 0.0;
+	if (velocity > 0.f)
+		steps = (1.0 - pos) / (velocity * dt);
+	else if (velocity < 0.f)
+		steps = pos / (-velocity * dt);
+	else
+		return UINT32_MAX;
+
+	return steps >= UINT32_MAX - 1 ? UINT32_MAX : static_cast<uint32_t>(steps) + 1;
+}
+
+// first step on which the age summed up tick by tick in float, like the kernels do, reaches maxAge
+static uint32_t expireStep(const float maxAge) {
+
+	constexpr unsigned stepsCount = static_cast<unsigned>(particleMaxLifetime / effectSimTimeStep) + 4;
+
+	static const auto ages = []() {
+		std::vector<float> ages(stepsCount);
+		float age = 0.f;
+		for (auto& stepAge : ages) {
+			age += static_cast<float>(effectSimTimeStep);
+			stepAge = age;
 		}
+		return ages;
+	}();
+
+	const auto it = std::lower_bound(ages.begin(), ages.end(), maxAge);
+	if (it != ages.end())
+		return static_cast<uint32_t>(it - ages.begin()) + 1;
+
+	return std::max(static_cast<uint32_t>(std::ceil(maxAge / effectSimTimeStep)), stepsCount + 1);
+}
+
+void Effect::scheduleDeaths() {
 
-		p.Deactivate();
+	const unsigned count = _particles.GetCount();
+	const double dt = effectSimTimeStep;
+
+	for (unsigned i = 0; i < count; ++i) {
+
+		const uint32_t exit = std::min(exitStep(_particles._x[i], _particles._vx[i], dt), exitStep(_particles._y[i], _particles._vy[i], dt));
+		const uint32_t expire = expireStep(_particles._maxAge[i]);
+
+		// leaving the square on the same step as expiring kills without an explosion, as in the kernels
+		const bool explodes = expire < exit && (_particles._flags[i] & ParticleFlagCanExplode) != 0;
+		const uint64_t step = std::min(exit, expire);
+
+		_deathEvents[i] = step << 32 | uint64_t(explodes) << 31 | i;
 	}
+
+	std::sort(_deathEvents, _deathEvents + count);
+
+	_nextDeathEvent = 0;
+	_eventLiveCount = count;
 }
 
-void Effect::update(const double dt) {
+void Effect::scheduleExpiries() {
 
-	//printf("effect %i Update\n", _num);
+	_expiryWheel.Clear(_effectStep + 1);
 
-	bool hasAliveParticlesNow = false;
+	for (unsigned i = 0; i < _particles.GetCount(); ++i)
+		_expiryWheel.Schedule(i, _effectStep + expireStep(_particles._maxAge[i]));
+}
 
-	auto& particlesToWrite = getParticlesToWrite();
+void Effect::expireParticles(const uint64_t tick) {
 
-	for (unsigned index = 0; index < particlesToWrite.size(); ++index) {
+	_expiryWheel.Advance([this, tick](const unsigned index) {
+
+		const uint64_t bit = uint64_t(1) << (index & 63);
+		uint64_t& killWord = _killMask[index >> 6];
+
+		// leaving the square on the same step as expiring kills without an explosion, as in the kernels
+		if (killWord & bit)
+			return;
+
+		killWord |= bit;
+
+		if (!(_particles._flags[index] & ParticleFlagCanExplode))
+			return;
+
+		ExplosionEvent event;
+		event._position = Vec2F(_particles._x[index], _particles._y[index]);
+		event._effect = _num;
+		event._tick = tick;
+
+		const bool pushed = _exploded.Push(event);
+		assert(pushed);
+		(void)pushed;
+	});
+}
 
-		auto& particleToWrite = particlesToWrite.at(index);
-		const bool alive = particleToWrite.IsAlive();
-		if (alive) {
+unsigned Effect::updateEvents(const uint64_t tick) {
 
-			particleToWrite.Update(dt);
-			checkParticleLife(particleToWrite, index);
+	const unsigned eventsCount = _particles.GetCount();
+	const unsigned firstEvent = _nextDeathEvent;
+	const float time = static_cast<float>(_effectStep * effectSimTimeStep);
 
-			hasAliveParticlesNow |= particleToWrite.IsAlive();
+	for (; _nextDeathEvent < eventsCount; ++_nextDeathEvent) {
+
+		const uint64_t event = _deathEvents[_nextDeathEvent];
+		if ((event >> 32) > _effectStep)
+			break;
+
+		const unsigned index = static_cast<unsigned>(event & 0x7fffffff);
+
+		if (event & (uint64_t(1) << 31)) {
+			ExplosionEvent explosion;
+			explosion._position = Vec2F(_particles._x[index] + _particles._vx[index] * time, _particles._y[index] + _particles._vy[index] * time);
+			explosion._effect = _num;
+			explosion._tick = tick;
+
+			const bool pushed = _exploded.Push(explosion);
+			assert(pushed);
+			(void)pushed;
 		}
+
+		_particles._flags[index] = 0;
+		--_eventLiveCount;
 	}
 
-	if (!hasAliveParticlesNow) {
-		const bool noExplosionsPending = _exploded[0].empty() && _exploded[1].empty();
+	if (_eventLiveCount == 0 && _exploded.Empty())
+		deactivate();
+
+	return _nextDeathEvent - firstEvent;
+}
+
+unsigned Effect::update(const double dt, const uint64_t tick) {
+
+	PROFILE_ZONE("Effect::update");
+
+	if (_stopRequested.exchange(false))
+		dropParticles();
+
+	if (_spawnPending)
+		spawnParticles();
+
+	++_effectStep;
+
+	// death steps were worked out for effectSimTimeStep, which is the only step the scheduler uses
+	if (_motionMode == ParticleMotionMode::EventDriven)
+		return updateEvents(tick);
+
+	//printf("effect %i Update\n", _num);
+
+	const unsigned count = _particles.GetCount();
+
+	const bool useWheel = _motionMode == ParticleMotionMode::IntegratedTimerWheel;
+
+	StepParticles(_particles, count, static_cast<float>(dt), _killMask, _explodeMask, !useWheel);
+
+	// the expiry steps filed in the wheel assume effectSimTimeStep, which is the only step the scheduler uses
+	if (useWheel)
+		expireParticles(tick);
+
+	retireParticles(_particles, count, tick);
+
+	if (_particles.GetCount() == 0) {
+		const bool noExplosionsPending = _exploded.Empty();
 		if (noExplosionsPending) {
 			deactivate();
 		}
 	}
+
+	return count;
 }
 
-void Effect::DetachThread() {
+bool Effect::BeginRead() const {
 
-	if (_thread.joinable() )
-	{
-		_thread.detach();
-	}
+	// pairs with unschedule: either this sees the effect dead or unschedule sees the reader, both sides use seq_cst
+	_readerActive = true;
+	if (_isAlive)
+		return true;
 
+	_readerActive = false;
+	return false;
 }
 
-void Effect::RequestThreadStop() {
-	_stopRequested = true;
+void Effect::EndRead() const {
+	_readerActive = false;
 }
 
-const std::vector<Particle>& Effect::GetParticles() const {
-	const auto& particles = getParticlesToRead();
-	return particles;
+const ParticlePool& Effect::GetParticles() const {
+
+	// renderer is the only reader of the snapshots
+	_snapshots.Update();
+	return _snapshots.GetReadBuffer();
 }
 
 void Effect::RequestSwapParticleBuffer() const {
 	
-	_swapBuffersRequested = true;
+	_publishRequested = true;
 }
 
-void Effect::swapExplodeBuffers() {
+void Effect::publishParticles() {
 
-	_explodeInd ^= 1;
-	_exploded[_explodeInd].clear();
-	_swapExplodesRequested = false;
+	PROFILE_ZONE("Effect::publishParticles");
 
-	//printf("effect %i swapExplodes, now %i \n", _num, _explodeInd.load());
-}
+	_publishRequested = false;
 
-void Effect::swapParticleBuffers() {
+	auto& snapshot = _snapshots.GetWriteBuffer();
 
-	_particleBufferInd ^= 1;
-	_swapBuffersRequested = false;
+	if (_motionMode == ParticleMotionMode::EventDriven)
+		publishEventParticles(snapshot);
+	else
+		snapshot.CopyVisualFrom(_particles);
 
-	auto& toWrite = getParticlesToWrite();
-	const auto& toRead = getParticlesToRead();
-	toWrite = toRead;
+	_snapshots.Publish();
 
-	//printf("effect %i swapBuffers, now %i \n", _num, _bufferInd.load());
+	//printf("effect %i publishParticles, count %u \n", _num, _particles.GetCount());
 }
 
-void Effect::start(const Vec2F pos) {
+void Effect::publishEventParticles(ParticlePool& snapshot) const {
 
-	//printf("effect %i start\n", _num);
+	const unsigned count = _particles.GetCount();
+	const float time = static_cast<float>(_effectStep * effectSimTimeStep);
 
-	_isThreadRunning = true;
+	snapshot.Clear();
+	unsigned index = snapshot.Add(_eventLiveCount);
 
-	const unsigned int numParticlesToGenerate = rndMinMax(1, maxParticlesPerEffectCount);
-	auto& particles = getParticlesToWrite();
+	// the only place positions are evaluated, dead particles are skipped and the snapshot comes out packed
+	for (unsigned i = 0; i < count; ++i) {
 
-	for (unsigned pIndex = 0; pIndex < numParticlesToGenerate; ++pIndex)
-	{
-		auto& p = particles[pIndex];
-		initParticle(p, pos);
+		if (!(_particles._flags[i] & ParticleFlagAlive))
+			continue;
+
+		snapshot._x[index] = _particles._x[i] + _particles._vx[i] * time;
+		snapshot._y[index] = _particles._y[i] + _particles._vy[i] * time;
+		snapshot._age[index] = time;
+		snapshot._maxAge[index] = _particles._maxAge[i];
+		snapshot._r[index] = _particles._r[i];
+		snapshot._g[index] = _particles._g[i];
+		snapshot._b[index] = _particles._b[i];
+		snapshot._flags[index] = _particles._flags[i];
+		++index;
 	}
+}
 
-	swapParticleBuffers();
+unsigned Effect::getLiveCount() const {
 
-	_prevUpdateTime = getTime();
-	_timeVault = 0;
+	return _motionMode == ParticleMotionMode::EventDriven ? _eventLiveCount : _particles.GetCount();
+}
 
-	while(_isAlive && !_stopRequested) {
+unsigned Effect::step(const double dt, const uint64_t tick) {
 
-		const auto currTime = getTime();
-		const auto dt = currTime - _prevUpdateTime;
+	if (!_isAlive)
+		return 0;
 
-		_timeVault += dt * effectSimTimeScale;
-		_prevUpdateTime = currTime;
+	const unsigned particlesStepped = update(dt, tick);
 
-		if (_timeVault < effectSimTimeStep) {
-			const double sleepTime = effectSimTimeStep - _timeVault;
-			const auto sleepMs = static_cast<unsigned>(sleepTime * 1000.0);
-			std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
-			continue;
-		}
+	if (_isAlive && _publishRequested)
+		publishParticles();
 
-		while (_isAlive && _timeVault >= effectSimTimeStep && !_stopRequested)
-		{
-			_timeVault -= effectSimTimeStep;
-			update(effectSimTimeStep);
-		}
+	return particlesStepped;
+}
 
-		if (_isAlive)
-		{
-			if (_swapBuffersRequested)
-				swapParticleBuffers();
-			
-			if (_swapExplodesRequested)
-				swapExplodeBuffers();
-		}
-	}
+bool Effect::unschedule() {
+
+	assert(!_isAlive);
 
-	_isThreadRunning = false;
+	// the renderer started drawing before the effect died, try again on a later tick
+	if (_readerActive)
+		return false;
+
+	releaseStorage();
+	_isScheduled = false;
+	return true;
 }
 
-void Effect::Start(const Vec2F& pos) {
+bool Effect::Start(const Vec2F& pos, const uint64_t seed, const unsigned particlesCount, const ParticleMotionMode motionMode) {
 
 	//printf("effect %i Start\n", _num);
 
-	
-	assert(!_isAlive && !_isThreadRunning);
+	assert(!_isAlive && !_isScheduled);
+	assert(particlesCount > 0 && particlesCount <= maxParticlesPerEffectCount);
+
+	_random.Seed(seed);
+	_motionMode = motionMode;
+	_effectStep = 0;
+
+	_spawnCount = particlesCount;
+	if (_blockPool && !acquireStorage(_spawnCount))
+		return false;
+
+	_spawnPosition = pos;
+	_spawnPending = true;
+
+	// hide the previous run's particles until the first step, clearing an untouched snapshot writes nothing
+	_snapshots.GetWriteBuffer().Clear();
+	_snapshots.Publish();
 
-	DetachThread();
-	_isAlive = true;
 	_stopRequested = false;
-	
-	_thread = std::thread([this, pos](){start(pos);});
+	_isScheduled = true;
+	_isAlive = true;
+	return true;
+}
+
+void Effect::spawnParticles() {
+
+	_spawnPending = false;
+
+	// event driven effects leave their dead particles behind
+	_particles.Clear();
+
+	initParticles(_particles, _spawnCount, _spawnPosition, _random);
+
+	if (_motionMode == ParticleMotionMode::EventDriven)
+		scheduleDeaths();
+	else if (_motionMode == ParticleMotionMode::IntegratedTimerWheel)
+		scheduleExpiries();
+
+	publishParticles();
+}
+
+void Effect::dropParticles() {
+
+	_spawnPending = false;
+
+	_particles.Clear();
+	_expiryWheel.Clear(_effectStep + 1);
+	_nextDeathEvent = 0;
+	_eventLiveCount = 0;
 }
 
 void Effect::deactivate() {
 	assert(_isAlive);
 	_isAlive = false;
 
-	swapParticleBuffers();
-	
-	RequestThreadStop();
-
 	//printf("effect %i deactivated\n", _num);
 }
 
@@ -1,64 +1,143 @@
 #pragma once
 #include <atomic>
-#include <set>
+#include <cstdint>
 #include <vector>
-#include <condition_variable>
-#include <thread>
-#include "Particle.h"
+#include "Config.h"
+#include "ParticlePool.h"
+#include "Random.h"
+#include "SpscRing.h"
+#include "TimerWheel.h"
+#include "TripleBuffer.h"
+
+class ParticleBlockPool;
+
+struct ExplosionEvent
+{
+	Vec2F _position;
+	unsigned _effect = 0;
+	uint64_t _tick = 0;
+};
+
+// Integrated moves every particle on every tick. IntegratedTimerWheel moves them the same way but files each
+// particle's expiry step in a TimerWheel, so the lifetime check only visits particles that actually expire.
+// EventDriven keeps only the spawn state, since motion is linear and lifetime fixed the step each particle dies
+// on is known at spawn: deaths are taken from a queue sorted by step and positions are only evaluated when a snapshot is published
+enum class ParticleMotionMode
+{
+	Integrated,
+	IntegratedTimerWheel,
+	EventDriven,
+};
 
 class Effect
 {
 public:
-	Effect();
+	// with a block pool the effect takes a block just big enough for its particles on every Start,
+	// otherwise it allocates buffers for maxParticlesPerEffectCount once
+	explicit Effect(ParticleBlockPool* blockPool = nullptr);
 	Effect(const Effect& other);
 
+	// bytes of per particle storage, particles, snapshots and bookkeeping, for up to capacity particles
+	static size_t GetStorageSize(unsigned capacity);
+
 	~Effect();	
 	
-	void Start(const Vec2F& pos);
-	
-	void RequestThreadStop();
-	void DetachThread();
+	// particles are spawned by the first step, on the worker thread, so that thread is the first to touch their memory.
+	// Returns false if no particle storage is left
+	bool Start(const Vec2F& pos, uint64_t seed, unsigned particlesCount, ParticleMotionMode motionMode = ParticleMotionMode::Integrated);
+
+	// may be called from any thread, the effect drops its particles on its next step and finishes
+	// as soon as its pending explosions are consumed
+	void RequestStop() { _stopRequested = true; }
 
 	bool IsAlive() const { return _isAlive; }
-	bool IsThreadRunning() const { return _isThreadRunning; }
+	bool IsScheduled() const { return _isScheduled; }
+
+	// the renderer brackets every GetParticles with these, so the storage of a finished effect is not recycled under it.
+	// BeginRead fails once the effect is no longer alive
+	bool BeginRead() const;
+	void EndRead() const;
 
-	const std::vector<Particle>& GetParticles() const;
+	const ParticlePool& GetParticles() const;
 	void RequestSwapParticleBuffer() const;
 	
 	//std::vector<ParticleVisualInfo> GetParticlesInfo() const;
-	std::set<Vec2F> GetExploded();
+
+	// single consumer side of the explosion ring, f is called for every pending ExplosionEvent
+	template<typename F>
+	size_t ConsumeExploded(F&& f) { return _exploded.Consume(f); }
 
 	unsigned _num = 0; //TODO DEBUG!!! REMOVE!!!
 
 protected:
-	const std::vector<Particle>& getParticlesToRead() const;
-	std::vector<Particle>& getParticlesToWrite();
-	void swapParticleBuffers();
-	void swapExplodeBuffers();
+	friend class EffectScheduler;
+	friend class Benchmark;
 
-	void start(Vec2F pos);
-	void update(double dt);
+	// returns the number of particles stepped, or of death events handled in EventDriven mode
+	unsigned step(double dt, uint64_t tick);
+	// hands the particle storage back, false while the renderer still reads the last snapshot
+	bool unschedule();
+
+	void publishParticles();
+
+	unsigned update(double dt, uint64_t tick);
 
 	void deactivate();
 
-	void checkParticleLife(Particle& p, unsigned index);
+	void spawnParticles();
+	void dropParticles();
+
+	// storage 0 detaches everything
+	void attachStorage(void* storage, unsigned capacity);
+	bool acquireStorage(unsigned count);
+	void releaseStorage();
+
+	void retireParticles(ParticlePool& particles, unsigned count, uint64_t tick);
+
+	void scheduleExpiries();
+	void expireParticles(uint64_t tick);
+
+	void scheduleDeaths();
+	unsigned updateEvents(uint64_t tick);
+	void publishEventParticles(ParticlePool& snapshot) const;
+
+	unsigned getLiveCount() const;
 
 private:
-	std::vector<Particle> _particles[2];
-	std::set<Vec2F> _exploded[2];
+	ParticlePool _particles;
+	Random _random;
+	mutable TripleBuffer<ParticlePool> _snapshots;
+	SpscRing<ExplosionEvent> _exploded;
+
+	uint64_t _killMask[(maxParticlesPerEffectCount + 63) / 64] = {};
+	uint64_t _explodeMask[(maxParticlesPerEffectCount + 63) / 64] = {};
+
+	ParticleMotionMode _motionMode = ParticleMotionMode::Integrated;
 
-	double _timeVault = 0.f;
-	double _prevUpdateTime = 0.f;
+	ParticleBlockPool* _blockPool = nullptr;
+	void* _ownedStorage = nullptr;
+	void* _block = nullptr;
+	unsigned _blockCapacity = 0;
 
-	std::thread _thread;
+	bool _spawnPending = false;
+	unsigned _spawnCount = 0;
+	Vec2F _spawnPosition;
+	// steps taken since Start
+	uint32_t _effectStep = 0;
+
+	// IntegratedTimerWheel only, handles are pool slots and follow particles moved by Remove
+	TimerWheel _expiryWheel;
+
+	// EventDriven only: _particles keeps spawn positions and is never compacted, each death event is
+	// step << 32 | explode bit << 31 | particle index, sorted at Start
+	uint64_t* _deathEvents = nullptr;
+	unsigned _nextDeathEvent = 0;
+	unsigned _eventLiveCount = 0;
 
-	std::atomic<unsigned> _particleBufferInd = 0;
-	std::atomic<unsigned> _explodeInd = 0;
 	std::atomic<bool> _isAlive = false;
-	std::atomic<bool> _isThreadRunning = false;
-	std::atomic<bool> _swapExplodesRequested = false;
-	mutable std::atomic<bool> _swapBuffersRequested = false;
-	
+	std::atomic<bool> _isScheduled = false;
 	std::atomic<bool> _stopRequested = false;
+	mutable std::atomic<bool> _publishRequested = false;
+	mutable std::atomic<bool> _readerActive = false;
 };
 
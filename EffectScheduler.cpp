@@ -0,0 +1,269 @@
+#include "EffectScheduler.h"
+#include <algorithm>
+#include <cassert>
+
+#include "Config.h"
+#include "Effect.h"
+#include "Profiler.h"
+#include "Utils.h"
+
+EffectScheduler::EffectScheduler(const unsigned workersCount) : _workersCount(workersCount), _timeScale(effectSimTimeScale) {
+
+	if (_workersCount == 0)
+		_workersCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	_workerStats = std::make_unique<WorkerStats[]>(_workersCount);
+
+	_liveEffects.reserve(maxEffectsCount);
+	_scheduledEffects.reserve(maxEffectsCount);
+
+	for (unsigned i = 0; i < _workersCount; ++i)
+		_deques.push_back(std::make_unique<WorkStealingDeque<Effect*>>(maxEffectsCount));
+}
+
+EffectScheduler::~EffectScheduler() {
+	Stop();
+}
+
+void EffectScheduler::Start() {
+
+	assert(!_clockThread.joinable());
+
+	_stopRequested = false;
+
+	// clock thread takes part in every tick as worker 0
+	for (unsigned i = 1; i < _workersCount; ++i)
+		_workers.emplace_back([this, i, generation = _tickGeneration]() {workerLoop(i, generation);});
+
+	_clockThread = std::thread([this]() {clockLoop();});
+}
+
+void EffectScheduler::Stop() {
+
+	{
+		std::lock_guard<std::mutex> lock(_tickMutex);
+		_stopRequested = true;
+	}
+	_tickStartedCV.notify_all();
+
+	if (_clockThread.joinable())
+		_clockThread.join();
+
+	for (auto& worker : _workers)
+		worker.join();
+
+	_workers.clear();
+}
+
+void EffectScheduler::Schedule(Effect* effect) {
+
+	std::lock_guard<std::mutex> lock(_scheduleMutex);
+	_scheduledEffects.push_back(effect);
+}
+
+void EffectScheduler::SetEffectFinishedCallback(std::function<void(Effect&)> callback) {
+
+	assert(!_clockThread.joinable());
+	_effectFinishedCallback = std::move(callback);
+}
+
+void EffectScheduler::clockLoop() {
+
+	PROFILE_THREAD_NAME("effect clock");
+
+	_prevUpdateTime = getTime();
+	_timeVault = 0;
+
+	while (!_stopRequested) {
+
+		const auto currTime = getTime();
+		const auto dt = currTime - _prevUpdateTime;
+
+		_timeVault += dt * _timeScale;
+		_prevUpdateTime = currTime;
+
+		if (_timeVault < effectSimTimeStep) {
+			const double sleepTime = effectSimTimeStep - _timeVault;
+			const auto sleepMs = static_cast<unsigned>(sleepTime * 1000.0);
+			std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+			continue;
+		}
+
+		_latency._wakeupDelay.Record(static_cast<uint64_t>((_timeVault - effectSimTimeStep) / _timeScale * 1e9));
+
+		unsigned steps = 0;
+		while (_timeVault >= effectSimTimeStep && !_stopRequested)
+		{
+			_timeVault -= effectSimTimeStep;
+
+			const uint64_t stepStart = getTimeNs();
+			tick();
+			_latency._stepTime.Record(getTimeNs() - stepStart);
+			++steps;
+		}
+
+		_latency._catchUpSteps.Record(steps);
+	}
+}
+
+void EffectScheduler::workerLoop(const unsigned workerInd, unsigned seenGeneration) {
+
+	PROFILE_THREAD_NAME("effect worker", static_cast<int>(workerInd));
+
+	while (true) {
+
+		{
+			std::unique_lock<std::mutex> lock(_tickMutex);
+			_tickStartedCV.wait(lock, [this, seenGeneration]() {
+				return _stopRequested || _tickGeneration != seenGeneration;
+			});
+
+			// a tick that has already started must be finished even if stop was requested meanwhile
+			if (_tickGeneration == seenGeneration)
+				return;
+
+			seenGeneration = _tickGeneration;
+		}
+
+		runTasks(workerInd);
+
+		{
+			std::lock_guard<std::mutex> lock(_tickMutex);
+			--_workersInTick;
+		}
+		_tickDoneCV.notify_one();
+	}
+}
+
+bool EffectScheduler::stealTask(const unsigned workerInd, Effect*& effect) {
+
+	for (unsigned i = 1; i < _workersCount; ++i) {
+		const unsigned victimInd = (workerInd + i) % _workersCount;
+		if (_deques[victimInd]->Steal(effect))
+			return true;
+	}
+
+	return false;
+}
+
+void EffectScheduler::runTasks(const unsigned workerInd) {
+
+	PROFILE_ZONE("EffectScheduler::runTasks");
+
+	const uint64_t startTime = getTimeNs();
+
+	auto& deque = *_deques[workerInd];
+	auto& stats = _workerStats[workerInd];
+
+	uint64_t particleUpdates = 0;
+	uint64_t effectUpdates = 0;
+	const uint64_t tick = _ticksCount;
+
+	const auto tasksCount = static_cast<unsigned>(_liveEffects.size());
+	for (unsigned taskInd = workerInd; taskInd < tasksCount; taskInd += _workersCount)
+		deque.Push(_liveEffects[taskInd]);
+
+	while (_pendingTasks > 0) {
+
+		Effect* effect = nullptr;
+		if (deque.Pop(effect) || stealTask(workerInd, effect)) {
+			particleUpdates += effect->step(effectSimTimeStep, tick);
+			++effectUpdates;
+			--_pendingTasks;
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+
+	stats._particleUpdates.fetch_add(particleUpdates, std::memory_order_relaxed);
+	stats._effectUpdates.fetch_add(effectUpdates, std::memory_order_relaxed);
+	stats._taskTime.Record(getTimeNs() - startTime);
+}
+
+uint64_t EffectScheduler::GetParticleUpdatesCount() const {
+
+	uint64_t count = 0;
+	for (unsigned i = 0; i < _workersCount; ++i)
+		count += _workerStats[i]._particleUpdates.load(std::memory_order_relaxed);
+
+	return count;
+}
+
+uint64_t EffectScheduler::GetEffectUpdatesCount() const {
+
+	uint64_t count = 0;
+	for (unsigned i = 0; i < _workersCount; ++i)
+		count += _workerStats[i]._effectUpdates.load(std::memory_order_relaxed);
+
+	return count;
+}
+
+void EffectScheduler::GetWorkerTaskTime(LatencyHistogram& target) const {
+
+	for (unsigned i = 0; i < _workersCount; ++i)
+		_workerStats[i]._taskTime.MergeInto(target);
+}
+
+void EffectScheduler::PrintLatency() const {
+
+	_latency.Print("effect clock");
+
+	auto taskTime = std::make_unique<LatencyHistogram>();
+	GetWorkerTaskTime(*taskTime);
+	taskTime->Print("worker task time", "us", 1000.0);
+}
+
+void EffectScheduler::tick() {
+
+	PROFILE_ZONE("EffectScheduler::tick");
+
+	{
+		std::lock_guard<std::mutex> lock(_scheduleMutex);
+		_liveEffects.insert(_liveEffects.end(), _scheduledEffects.begin(), _scheduledEffects.end());
+		_scheduledEffects.clear();
+	}
+
+	if (_liveEffects.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(_tickMutex);
+
+		// workers may already have left on stop, nobody would pick up their share
+		if (_stopRequested)
+			return;
+
+		++_ticksCount;
+		_pendingTasks = static_cast<unsigned>(_liveEffects.size());
+		_workersInTick = _workersCount - 1;
+		++_tickGeneration;
+	}
+	_tickStartedCV.notify_all();
+
+	runTasks(0);
+
+	{
+		// live list must not be touched until every worker is done seeding its deque from it
+		std::unique_lock<std::mutex> lock(_tickMutex);
+		_tickDoneCV.wait(lock, [this]() {
+			return _workersInTick == 0;
+		});
+	}
+
+	const auto isFinished = [this](Effect* effect) {
+		if (effect->IsAlive())
+			return false;
+
+		// stays in the live list until the renderer lets go of its last snapshot
+		if (!effect->unschedule())
+			return false;
+
+		if (_effectFinishedCallback)
+			_effectFinishedCallback(*effect);
+
+		return true;
+	};
+
+	_liveEffects.erase(std::remove_if(_liveEffects.begin(), _liveEffects.end(), isFinished), _liveEffects.end());
+}
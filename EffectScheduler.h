@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "LatencyHistogram.h"
+#include "WorkStealingDeque.h"
+
+class Effect;
+
+// Owns a fixed set of worker threads which step every live effect on a shared effectSimTimeStep tick.
+// Each tick every worker seeds its own deque with a share of the live effects and steals from the others once it runs dry.
+class EffectScheduler
+{
+public:
+	explicit EffectScheduler(unsigned workersCount = 0);
+	~EffectScheduler();
+
+	void Start();
+	void Stop();
+
+	void Schedule(Effect* effect);
+
+	// called on the clock thread, at the end of a tick once every worker is done with it, for every effect that has
+	// finished and left the scheduler; runs concurrently with ParticleSystem::update and the renderer, not with workers
+	void SetEffectFinishedCallback(std::function<void(Effect&)> callback);
+
+	unsigned GetWorkersCount() const { return _workersCount; }
+
+	void SetTimeScale(double timeScale) { _timeScale = timeScale; }
+
+	uint64_t GetTicksCount() const { return _ticksCount; }
+	uint64_t GetParticleUpdatesCount() const;
+	uint64_t GetEffectUpdatesCount() const;
+
+	// clock loop timings, step time covers a whole tick
+	const LoopLatency& GetLatency() const { return _latency; }
+	// time each worker spent on its share of a tick, merged over all workers
+	void GetWorkerTaskTime(LatencyHistogram& target) const;
+	void PrintLatency() const;
+
+protected:
+	void clockLoop();
+	void workerLoop(unsigned workerInd, unsigned seenGeneration);
+
+	void tick();
+	void runTasks(unsigned workerInd);
+	bool stealTask(unsigned workerInd, Effect*& effect);
+
+private:
+	struct alignas(64) WorkerStats
+	{
+		std::atomic<uint64_t> _particleUpdates = 0;
+		std::atomic<uint64_t> _effectUpdates = 0;
+		LatencyHistogram _taskTime;
+	};
+
+	unsigned _workersCount = 0;
+	std::unique_ptr<WorkerStats[]> _workerStats;
+
+	std::thread _clockThread;
+	std::vector<std::thread> _workers;
+
+	std::function<void(Effect&)> _effectFinishedCallback;
+
+	std::vector<Effect*> _liveEffects;
+	std::vector<Effect*> _scheduledEffects;
+	std::mutex _scheduleMutex;
+
+	std::vector<std::unique_ptr<WorkStealingDeque<Effect*>>> _deques;
+	std::atomic<unsigned> _pendingTasks = 0;
+
+	std::mutex _tickMutex;
+	std::condition_variable _tickStartedCV;
+	std::condition_variable _tickDoneCV;
+	unsigned _tickGeneration = 0;
+	std::atomic<uint64_t> _ticksCount = 0;
+	unsigned _workersInTick = 0;
+
+	double _timeVault = 0.f;
+	double _prevUpdateTime = 0.f;
+	std::atomic<double> _timeScale;
+
+	LoopLatency _latency;
+
+	std::atomic<bool> _stopRequested = false;
+};
@@ -0,0 +1,249 @@
+#include "ExplosionQueue.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include "Utils.h"
+
+ExplosionQueue::ExplosionQueue(const unsigned capacity) :
+	_entries(capacity),
+	_next(capacity, none),
+	_prev(capacity, none),
+	_cellOf(capacity, none),
+	_sequence(capacity, 0),
+	_cells(fairnessGridSize * fairnessGridSize)
+{
+	_freeSlots.reserve(capacity);
+	_heap.reserve(capacity);
+	Clear();
+}
+
+void ExplosionQueue::SetPolicy(const ExplosionAdmissionPolicy policy) {
+
+	assert(Empty());
+	_policy = policy;
+}
+
+unsigned ExplosionQueue::cellIndex(const Vec2F& position) const {
+
+	if (_policy != ExplosionAdmissionPolicy::SpatialFairness)
+		return 0;
+
+	const auto toCell = [](const float coord) {
+		const int cell = static_cast<int>(coord * fairnessGridSize);
+		return static_cast<unsigned>(std::clamp(cell, 0, static_cast<int>(fairnessGridSize) - 1));
+	};
+
+	return toCell(position._y) * fairnessGridSize + toCell(position._x);
+}
+
+bool ExplosionQueue::olderThan(const uint32_t a, const uint32_t b) const {
+
+	if (_entries[a]._tick != _entries[b]._tick)
+		return _entries[a]._tick < _entries[b]._tick;
+
+	return _sequence[a] < _sequence[b];
+}
+
+template<typename F>
+void ExplosionQueue::forEachPending(F&& f) const {
+
+	if (_policy == ExplosionAdmissionPolicy::AgePriority) {
+		for (const uint32_t slot : _heap)
+			f(slot);
+		return;
+	}
+
+	for (const auto& cell : _cells)
+		for (uint32_t slot = cell._head; slot != none; slot = _next[slot])
+			f(slot);
+}
+
+void ExplosionQueue::recordAbandoned(const uint32_t slot) {
+	_abandonedWaitTime.Record(getTimeNs() - _entries[slot]._pushTimeNs);
+}
+
+void ExplosionQueue::link(const uint32_t slot, const unsigned cell) {
+
+	auto& target = _cells[cell];
+
+	_cellOf[slot] = cell;
+	_prev[slot] = target._tail;
+	_next[slot] = none;
+
+	if (target._tail != none)
+		_next[target._tail] = slot;
+	else
+		target._head = slot;
+
+	target._tail = slot;
+	++target._count;
+}
+
+void ExplosionQueue::unlink(const uint32_t slot) {
+
+	auto& cell = _cells[_cellOf[slot]];
+
+	if (_prev[slot] != none)
+		_next[_prev[slot]] = _next[slot];
+	else
+		cell._head = _next[slot];
+
+	if (_next[slot] != none)
+		_prev[_next[slot]] = _prev[slot];
+	else
+		cell._tail = _prev[slot];
+
+	--cell._count;
+	_cellOf[slot] = none;
+}
+
+void ExplosionQueue::remove(const uint32_t slot) {
+
+	if (_policy == ExplosionAdmissionPolicy::AgePriority) {
+		// only ever the oldest one
+		assert(!_heap.empty() && _heap.front() == slot);
+		std::pop_heap(_heap.begin(), _heap.end(), [this](const uint32_t a, const uint32_t b) { return olderThan(b, a); });
+		_heap.pop_back();
+	}
+	else {
+		unlink(slot);
+	}
+
+	_freeSlots.push_back(slot);
+	--_count;
+}
+
+bool ExplosionQueue::Push(const PendingExplosion& explosion) {
+
+	_pushedCount.fetch_add(1, std::memory_order_relaxed);
+
+	const unsigned cell = cellIndex(explosion._position);
+	bool dropped = false;
+
+	if (_count == GetCapacity()) {
+
+		dropped = true;
+		_droppedCount.fetch_add(1, std::memory_order_relaxed);
+
+		if (_policy != ExplosionAdmissionPolicy::SpatialFairness || GetCapacity() == 0)
+			return false;
+
+		unsigned crowdedCell = cell;
+		for (unsigned i = 0; i < _cells.size(); ++i)
+			if (_cells[i]._count > _cells[crowdedCell]._count)
+				crowdedCell = i;
+
+		// the newcomer's cell is as crowded as any, it goes
+		if (crowdedCell == cell)
+			return false;
+
+		const uint32_t evicted = _cells[crowdedCell]._tail;
+		recordAbandoned(evicted);
+		remove(evicted);
+	}
+
+	const uint32_t slot = _freeSlots.back();
+	_freeSlots.pop_back();
+
+	_entries[slot] = explosion;
+	_entries[slot]._pushTimeNs = getTimeNs();
+	_sequence[slot] = _nextSequence++;
+
+	if (_policy == ExplosionAdmissionPolicy::AgePriority) {
+		_heap.push_back(slot);
+		std::push_heap(_heap.begin(), _heap.end(), [this](const uint32_t a, const uint32_t b) { return olderThan(b, a); });
+	}
+	else {
+		link(slot, cell);
+	}
+
+	++_count;
+	return !dropped;
+}
+
+unsigned ExplosionQueue::frontCell() const {
+
+	for (unsigned i = 0; i < _cells.size(); ++i) {
+		const unsigned cell = (_roundRobinCell + i) % _cells.size();
+		if (_cells[cell]._count > 0)
+			return cell;
+	}
+
+	assert(false);
+	return 0;
+}
+
+PendingExplosion& ExplosionQueue::Front() {
+
+	assert(!Empty());
+
+	if (_policy == ExplosionAdmissionPolicy::AgePriority)
+		return _entries[_heap.front()];
+
+	return _entries[_cells[frontCell()]._head];
+}
+
+void ExplosionQueue::Pop() {
+
+	assert(!Empty());
+
+	uint32_t slot = none;
+
+	if (_policy == ExplosionAdmissionPolicy::AgePriority) {
+		slot = _heap.front();
+	}
+	else {
+		const unsigned cell = frontCell();
+		slot = _cells[cell]._head;
+		// the next cell gets the next turn
+		_roundRobinCell = (cell + 1) % _cells.size();
+	}
+
+	_waitTime.Record(getTimeNs() - _entries[slot]._pushTimeNs);
+	remove(slot);
+}
+
+void ExplosionQueue::Clear() {
+
+	forEachPending([this](const uint32_t slot) {
+		recordAbandoned(slot);
+	});
+
+	_freeSlots.clear();
+	for (unsigned slot = GetCapacity(); slot > 0; --slot)
+		_freeSlots.push_back(slot - 1);
+
+	std::fill(_cells.begin(), _cells.end(), Cell());
+	std::fill(_cellOf.begin(), _cellOf.end(), none);
+	_heap.clear();
+
+	_count = 0;
+	_roundRobinCell = 0;
+}
+
+void ExplosionQueue::RecordDepth() {
+
+	_depth.Record(_count);
+
+	uint64_t oldestPushTime = UINT64_MAX;
+	forEachPending([this, &oldestPushTime](const uint32_t slot) {
+		oldestPushTime = std::min(oldestPushTime, _entries[slot]._pushTimeNs);
+	});
+
+	_pendingCount.store(_count, std::memory_order_relaxed);
+	_oldestPushTimeNs.store(_count > 0 ? oldestPushTime : 0, std::memory_order_relaxed);
+}
+
+void ExplosionQueue::Print() const {
+
+	const unsigned pendingCount = _pendingCount.load(std::memory_order_relaxed);
+	const uint64_t oldestPushTime = _oldestPushTimeNs.load(std::memory_order_relaxed);
+	const double oldestWaitMs = pendingCount > 0 ? (getTimeNs() - oldestPushTime) / 1000000.0 : 0.0;
+
+	printf("pending explosions: pushed %llu, dropped %llu, capacity %u, still pending %u, oldest waiting %.1f ms\n",
+		static_cast<unsigned long long>(GetPushedCount()), static_cast<unsigned long long>(GetDroppedCount()), GetCapacity(),
+		pendingCount, oldestWaitMs);
+	_depth.Print("queue depth", "explosions", 1.0);
+	_waitTime.Print("wait time", "ms", 1000000.0);
+	_abandonedWaitTime.Print("wait until dropped", "ms", 1000000.0);
+}
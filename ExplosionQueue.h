@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "LatencyHistogram.h"
+#include "Particle.h"
+
+// order in which pending explosions are admitted
+enum class ExplosionAdmissionPolicy
+{
+	// as they reached the particle system
+	Fifo,
+	// earliest effect tick first, so explosions from effects stepped late do not jump ahead of older ones
+	AgePriority,
+	// round robin over a grid of scene cells, oldest first within a cell, so one busy spot cannot starve the rest
+	SpatialFairness,
+};
+
+struct PendingExplosion
+{
+	Vec2F _position;
+	unsigned _particlesCount = 0;
+	// effect tick the explosion happened on
+	uint64_t _tick = 0;
+	// set by Push
+	uint64_t _pushTimeNs = 0;
+	// particle system step it was queued on
+	uint64_t _systemStep = 0;
+};
+
+// Bounded queue of explosions waiting for an effect slot and particle budget, carried over between particle system
+// steps. All storage is allocated up front. When full, Fifo and AgePriority reject the newcomer, SpatialFairness drops
+// the newest explosion of the most crowded cell. Used by the particle system thread only, metrics may be printed from any thread.
+class ExplosionQueue
+{
+public:
+	static constexpr unsigned fairnessGridSize = 8;
+
+	explicit ExplosionQueue(unsigned capacity);
+
+	// only while empty
+	void SetPolicy(ExplosionAdmissionPolicy policy);
+	ExplosionAdmissionPolicy GetPolicy() const { return _policy; }
+
+	// false if an explosion had to be dropped to stay within capacity, either this one or a queued one
+	bool Push(const PendingExplosion& explosion);
+
+	bool Empty() const { return _count == 0; }
+	unsigned GetCount() const { return _count; }
+	unsigned GetCapacity() const { return static_cast<unsigned>(_entries.size()); }
+
+	// next explosion to admit, the queue must not be empty
+	PendingExplosion& Front();
+	// admits Front and records how long it waited
+	void Pop();
+	void Clear();
+
+	// called once per particle system step, also notes how long the oldest pending explosion has been waiting
+	void RecordDepth();
+
+	uint64_t GetPushedCount() const { return _pushedCount.load(std::memory_order_relaxed); }
+	uint64_t GetDroppedCount() const { return _droppedCount.load(std::memory_order_relaxed); }
+
+	void Print() const;
+
+private:
+	struct Cell
+	{
+		uint32_t _head = none;
+		uint32_t _tail = none;
+		unsigned _count = 0;
+	};
+
+	static constexpr uint32_t none = UINT32_MAX;
+
+	unsigned cellIndex(const Vec2F& position) const;
+	unsigned frontCell() const;
+	bool olderThan(uint32_t a, uint32_t b) const;
+
+	// calls f for the slot of every queued explosion
+	template<typename F>
+	void forEachPending(F&& f) const;
+	// records how long an explosion waited before it was dropped or cleared
+	void recordAbandoned(uint32_t slot);
+
+	void link(uint32_t slot, unsigned cell);
+	void unlink(uint32_t slot);
+	void remove(uint32_t slot);
+
+	ExplosionAdmissionPolicy _policy = ExplosionAdmissionPolicy::Fifo;
+
+	// entries live in fixed slots, linked per cell in arrival order. Fifo uses a single cell,
+	// AgePriority keeps a heap of slots on top of it
+	std::vector<PendingExplosion> _entries;
+	std::vector<uint32_t> _next;
+	std::vector<uint32_t> _prev;
+	std::vector<uint32_t> _cellOf;
+	std::vector<uint32_t> _freeSlots;
+	std::vector<uint64_t> _sequence;
+	std::vector<uint32_t> _heap;
+	std::vector<Cell> _cells;
+
+	unsigned _count = 0;
+	unsigned _roundRobinCell = 0;
+	uint64_t _nextSequence = 0;
+
+	std::atomic<uint64_t> _pushedCount = 0;
+	std::atomic<uint64_t> _droppedCount = 0;
+
+	LatencyHistogram _depth;
+	// wall time from Push to Pop, ns
+	LatencyHistogram _waitTime;
+	// wall time from Push until a queued explosion was dropped to make room or cleared, ns
+	LatencyHistogram _abandonedWaitTime;
+
+	// as of the last RecordDepth
+	std::atomic<unsigned> _pendingCount = 0;
+	std::atomic<uint64_t> _oldestPushTimeNs = 0;
+};
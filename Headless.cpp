@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <thread>
+
+#include "ParticleSystem.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "SoftwareRenderer.h"
+#include "Utils.h"
+#include "WorkerPool.h"
+
+struct HeadlessOptions
+{
+	double _duration = 10.0;
+	double _timeScale = 1.0;
+	unsigned _threads = 0;
+	uint64_t _seed = 0;
+	bool _hasSeed = false;
+	const char* _tracePath = nullptr;
+	ParticleMotionMode _motionMode = ParticleMotionMode::Integrated;
+	ParticleBudgetPolicy _budgetPolicy = ParticleBudgetPolicy::Shrink;
+	ExplosionAdmissionPolicy _admissionPolicy = ExplosionAdmissionPolicy::Fifo;
+	bool _softwareRender = false;
+	int _width = sceneWidth;
+	int _height = sceneHeight;
+	bool _help = false;
+};
+
+static const char* getMotionModeName(const ParticleMotionMode motionMode) {
+
+	switch (motionMode) {
+	case ParticleMotionMode::IntegratedTimerWheel: return "integrated, timer wheel";
+	case ParticleMotionMode::EventDriven: return "event driven";
+	default: return "integrated";
+	}
+}
+
+static const char* getBudgetPolicyName(const ParticleBudgetPolicy policy) {
+
+	switch (policy) {
+	case ParticleBudgetPolicy::Defer: return "defer";
+	case ParticleBudgetPolicy::DropOldest: return "drop oldest";
+	default: return "shrink";
+	}
+}
+
+static const char* getAdmissionPolicyName(const ExplosionAdmissionPolicy policy) {
+
+	switch (policy) {
+	case ExplosionAdmissionPolicy::AgePriority: return "age priority";
+	case ExplosionAdmissionPolicy::SpatialFairness: return "spatial fairness";
+	default: return "fifo";
+	}
+}
+
+static void printUsage(const char* exe) {
+
+	printf("usage: %s [--help] [--duration seconds] [--seed n] [--threads n] [--timescale x] [--motion integrated|wheel|events]\n", exe);
+	printf("       [--budget shrink|defer|oldest] [--admission fifo|age|spatial] [--render none|software]\n");
+	printf("       [--width pixels] [--height pixels] [--trace file]\n");
+	printf("  --duration   wall-clock seconds to run, default 10\n");
+	printf("  --seed       base random seed, random by default\n");
+	printf("  --threads    effect worker threads, default one per hardware thread\n");
+	printf("  --timescale  simulated seconds per wall-clock second, default 1\n");
+	printf("  --motion     integrated steps every particle each tick, wheel also files expiries in a timer wheel,\n");
+	printf("               events only handles deaths, default integrated\n");
+	printf("  --budget     what to do with effects over the particle budget: shrink them, defer them until particles\n");
+	printf("               are freed or stop the oldest effects to make room, default shrink\n");
+	printf("  --admission  order pending explosions start in: as they arrive, oldest effect tick first or round robin\n");
+	printf("               over scene cells, default fifo\n");
+	printf("  --render     software draws frames on the cpu into memory while the simulation runs, default none\n");
+	printf("  --width      software frame width, default %d\n", sceneWidth);
+	printf("  --height     software frame height, default %d\n", sceneHeight);
+	printf("  --trace      write a Chrome trace-event JSON on exit, needs a build with PP_ENABLE_PROFILER\n");
+}
+
+static bool parseOptions(const int argc, char** argv, HeadlessOptions& options) {
+
+	for (int i = 1; i < argc; ++i) {
+
+		const char* arg = argv[i];
+
+		if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+			options._help = true;
+			return true;
+		}
+
+		// every other option takes a value
+		static const char* valueOptions[] = {
+			"--duration", "--seed", "--threads", "--timescale", "--motion", "--budget", "--admission",
+			"--render", "--width", "--height", "--trace"};
+
+		const bool takesValue = std::any_of(std::begin(valueOptions), std::end(valueOptions), [arg](const char* option) {
+			return strcmp(arg, option) == 0;
+		});
+
+		if (!takesValue) {
+			fprintf(stderr, "ERROR: unknown option %s\n", arg);
+			return false;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value) {
+			fprintf(stderr, "ERROR: missing value for %s\n", arg);
+			return false;
+		}
+
+		if (strcmp(arg, "--duration") == 0) {
+			options._duration = atof(value);
+		}
+		else if (strcmp(arg, "--seed") == 0) {
+			options._seed = strtoull(value, nullptr, 10);
+			options._hasSeed = true;
+		}
+		else if (strcmp(arg, "--threads") == 0) {
+			options._threads = static_cast<unsigned>(atoi(value));
+		}
+		else if (strcmp(arg, "--timescale") == 0) {
+			options._timeScale = atof(value);
+		}
+		else if (strcmp(arg, "--motion") == 0) {
+			if (strcmp(value, "integrated") == 0)
+				options._motionMode = ParticleMotionMode::Integrated;
+			else if (strcmp(value, "wheel") == 0)
+				options._motionMode = ParticleMotionMode::IntegratedTimerWheel;
+			else if (strcmp(value, "events") == 0)
+				options._motionMode = ParticleMotionMode::EventDriven;
+			else {
+				fprintf(stderr, "ERROR: unknown motion mode %s\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--budget") == 0) {
+			if (strcmp(value, "shrink") == 0)
+				options._budgetPolicy = ParticleBudgetPolicy::Shrink;
+			else if (strcmp(value, "defer") == 0)
+				options._budgetPolicy = ParticleBudgetPolicy::Defer;
+			else if (strcmp(value, "oldest") == 0)
+				options._budgetPolicy = ParticleBudgetPolicy::DropOldest;
+			else {
+				fprintf(stderr, "ERROR: unknown budget policy %s\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--admission") == 0) {
+			if (strcmp(value, "fifo") == 0)
+				options._admissionPolicy = ExplosionAdmissionPolicy::Fifo;
+			else if (strcmp(value, "age") == 0)
+				options._admissionPolicy = ExplosionAdmissionPolicy::AgePriority;
+			else if (strcmp(value, "spatial") == 0)
+				options._admissionPolicy = ExplosionAdmissionPolicy::SpatialFairness;
+			else {
+				fprintf(stderr, "ERROR: unknown admission policy %s\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--render") == 0) {
+			if (strcmp(value, "none") == 0)
+				options._softwareRender = false;
+			else if (strcmp(value, "software") == 0)
+				options._softwareRender = true;
+			else {
+				fprintf(stderr, "ERROR: unknown render backend %s\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--width") == 0) {
+			options._width = atoi(value);
+		}
+		else if (strcmp(arg, "--height") == 0) {
+			options._height = atoi(value);
+		}
+		else if (strcmp(arg, "--trace") == 0) {
+			options._tracePath = value;
+		}
+		else {
+			fprintf(stderr, "ERROR: unknown option %s\n", arg);
+			return false;
+		}
+
+		++i;
+	}
+
+	return options._duration > 0.0 && options._timeScale > 0.0 && options._width > 0 && options._height > 0;
+}
+
+int main(int argc, char** argv)
+{
+	HeadlessOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	if (options._help) {
+		printUsage(argv[0]);
+		return 0;
+	}
+
+	if (options._hasSeed)
+		SetRandomSeed(options._seed);
+
+	if (options._tracePath && !Profiler::Start(options._tracePath)) {
+		fprintf(stderr, "ERROR: profiler is not compiled in, configure with -DPP_ENABLE_PROFILER=ON\n");
+		return 1;
+	}
+
+	ParticleSystem system(options._threads);
+	system.SetTimeScale(options._timeScale);
+	system.SetMotionMode(options._motionMode);
+	system.SetBudgetPolicy(options._budgetPolicy);
+	system.SetAdmissionPolicy(options._admissionPolicy);
+
+	printf("headless: seed %llu, threads %u, timescale %.2f, duration %.2f s, %s motion\n",
+		static_cast<unsigned long long>(GetRandomSeed()), system.GetScheduler().GetWorkersCount(), options._timeScale, options._duration,
+		getMotionModeName(options._motionMode));
+	printf("budget policy %s, admission %s\n", getBudgetPolicyName(options._budgetPolicy), getAdmissionPolicyName(options._admissionPolicy));
+
+	const auto& arena = system.GetArena();
+	printf("particle arena %.1f MB reserved, huge pages %s\n", arena.GetSize() / 1048576.0, arena.HasHugePages() ? "requested" : "off");
+
+	std::unique_ptr<SoftwareRenderer> renderer;
+	if (options._softwareRender)
+		renderer = std::make_unique<SoftwareRenderer>(options._width, options._height,
+			WorkerPool::GetSpareWorkersCount(system.GetScheduler().GetWorkersCount()));
+
+	const double startTime = getTime();
+	system.Start();
+
+	// frames are paced like the GL renderer's
+	constexpr double renderMinCooldown = 0.015;
+	double nextFrameTime = startTime;
+
+	while (!system.IsStopRequested() && getTime() - startTime < options._duration) {
+
+		if (!renderer) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+
+		const double now = getTime();
+		if (now < nextFrameTime) {
+			std::this_thread::sleep_for(std::chrono::duration<double>(nextFrameTime - now));
+			continue;
+		}
+
+		renderer->Render(system.GetEffects());
+		nextFrameTime = std::max(nextFrameTime + renderMinCooldown, now);
+	}
+
+	const bool diedOut = system.IsStopRequested();
+	system.Stop();
+
+	const double elapsed = getTime() - startTime;
+
+	const auto& scheduler = system.GetScheduler();
+	const auto& slots = system.GetEffectSlots();
+
+	const double particleUpdates = static_cast<double>(scheduler.GetParticleUpdatesCount());
+	// effects that really started, slot acquires rolled back by a failed start or the budget are not counted
+	const double effectsSpawned = static_cast<double>(system.GetBudget().GetCount(ParticleBudgetOutcome::Started));
+
+	printf("finished after %.2f s%s\n", elapsed, diedOut ? " (all effects died out)" : "");
+	printf("ticks %llu, effect updates %llu, no free effect slot %llu times\n",
+		static_cast<unsigned long long>(scheduler.GetTicksCount()),
+		static_cast<unsigned long long>(scheduler.GetEffectUpdatesCount()),
+		static_cast<unsigned long long>(slots.GetFailedAcquireCount()));
+	printf("particle updates %.0f, %.0f / sec\n", particleUpdates, particleUpdates / elapsed);
+	printf("effects spawned %.0f, %.2f / sec\n", effectsSpawned, effectsSpawned / elapsed);
+	printf("particle blocks peak %.2f MB, arena carved %.2f MB\n",
+		system.GetParticleBlocks().GetPeakAcquiredBytes() / 1048576.0, arena.GetUsed() / 1048576.0);
+	system.GetBudget().Print();
+	system.GetPendingExplosions().Print();
+
+	system.PrintLatency();
+
+	if (renderer)
+		renderer->Print();
+
+	Profiler::Stop();
+
+	return 0;
+}
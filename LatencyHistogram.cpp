@@ -0,0 +1,119 @@
+#include "LatencyHistogram.h"
+#include <cstdio>
+#include <memory>
+
+#include "ParticleKernels.h"
+
+unsigned LatencyHistogram::bucketIndex(const uint64_t value) {
+
+	if (value < 2 * subBucketsCount)
+		return static_cast<unsigned>(value);
+
+	// keep the top subBucketBits + 1 bits, the leading one selects the power of two
+	const unsigned shift = highestSetBit(value) - subBucketBits;
+	return (shift + 1) * subBucketsCount + static_cast<unsigned>((value >> shift) - subBucketsCount);
+}
+
+uint64_t LatencyHistogram::bucketHighestValue(const unsigned index) {
+
+	if (index < 2 * subBucketsCount)
+		return index;
+
+	const unsigned shift = index / subBucketsCount - 1;
+	const uint64_t lowest = static_cast<uint64_t>(index % subBucketsCount + subBucketsCount) << shift;
+	return lowest + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::Record(const uint64_t value) {
+
+	// single writer, plain load and store are enough and avoid locked instructions
+	auto& count = _counts[bucketIndex(value)];
+	count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	if (value > _max.load(std::memory_order_relaxed))
+		_max.store(value, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::MergeInto(LatencyHistogram& target) const {
+
+	for (unsigned i = 0; i < bucketsCount; ++i) {
+		const uint64_t count = _counts[i].load(std::memory_order_relaxed);
+		if (count != 0)
+			target._counts[i].fetch_add(count, std::memory_order_relaxed);
+	}
+
+	const uint64_t max = GetMax();
+	uint64_t targetMax = target._max.load(std::memory_order_relaxed);
+	while (max > targetMax && !target._max.compare_exchange_weak(targetMax, max, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::Reset() {
+
+	for (auto& count : _counts)
+		count.store(0, std::memory_order_relaxed);
+
+	_max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+
+	uint64_t total = 0;
+	for (const auto& count : _counts)
+		total += count.load(std::memory_order_relaxed);
+
+	return total;
+}
+
+uint64_t LatencyHistogram::GetPercentile(const double percentile) const {
+
+	// percentiles of a live histogram are taken from one copy, so they agree with each other
+	uint64_t counts[bucketsCount];
+	uint64_t total = 0;
+
+	for (unsigned i = 0; i < bucketsCount; ++i) {
+		counts[i] = _counts[i].load(std::memory_order_relaxed);
+		total += counts[i];
+	}
+
+	if (total == 0)
+		return 0;
+
+	uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (unsigned i = 0; i < bucketsCount; ++i) {
+		seen += counts[i];
+		if (seen >= rank) {
+			const uint64_t value = bucketHighestValue(i);
+			const uint64_t max = GetMax();
+			return value < max ? value : max;
+		}
+	}
+
+	return GetMax();
+}
+
+void LatencyHistogram::Print(const char* name, const char* unit, const double unitScale) const {
+
+	// snapshot first, the owner may still be recording
+	auto snapshot = std::make_unique<LatencyHistogram>();
+	MergeInto(*snapshot);
+
+	printf("  %-22s n %-9llu p50 %9.1f  p99 %9.1f  p999 %9.1f  max %9.1f %s\n", name,
+		static_cast<unsigned long long>(snapshot->GetCount()),
+		snapshot->GetPercentile(50.0) / unitScale,
+		snapshot->GetPercentile(99.0) / unitScale,
+		snapshot->GetPercentile(99.9) / unitScale,
+		snapshot->GetMax() / unitScale,
+		unit);
+}
+
+void LoopLatency::Print(const char* loopName) const {
+
+	printf("%s latency:\n", loopName);
+	_stepTime.Print("step time", "us", 1000.0);
+	_wakeupDelay.Print("wakeup delay", "us", 1000.0);
+	_catchUpSteps.Print("catch-up steps", "steps", 1.0);
+}
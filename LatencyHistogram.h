@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// HDR-style log-linear histogram: exact below 64, then 32 linear sub-buckets per power of two (about 3% error).
+// Recording is lock-free and meant for a single owner thread, any thread may read or merge it at the same time.
+class LatencyHistogram
+{
+public:
+	static constexpr unsigned subBucketBits = 5;
+	static constexpr unsigned subBucketsCount = 1u << subBucketBits;
+	static constexpr unsigned bucketsCount = (64 - subBucketBits + 1) * subBucketsCount;
+
+	void Record(uint64_t value);
+
+	// adds the counts recorded so far to target, safe while the owner keeps recording
+	void MergeInto(LatencyHistogram& target) const;
+	void Reset();
+
+	uint64_t GetCount() const;
+	uint64_t GetMax() const { return _max.load(std::memory_order_relaxed); }
+
+	// highest value equivalent to the given percentile (0..100)
+	uint64_t GetPercentile(double percentile) const;
+
+	// values are divided by unitScale for printing, e.g. 1000 to print nanoseconds as microseconds
+	void Print(const char* name, const char* unit, double unitScale) const;
+
+private:
+	static unsigned bucketIndex(uint64_t value);
+	static uint64_t bucketHighestValue(unsigned index);
+
+	std::atomic<uint64_t> _counts[bucketsCount] = {};
+	std::atomic<uint64_t> _max = 0;
+};
+
+// latencies of one fixed timestep loop, recorded by the loop's own thread
+struct LoopLatency
+{
+	// wall time spent in one step, ns
+	LatencyHistogram _stepTime;
+	// how late the first step of a wakeup ran compared to when it was due, ns
+	LatencyHistogram _wakeupDelay;
+	// steps run back to back on one wakeup
+	LatencyHistogram _catchUpSteps;
+
+	void Print(const char* loopName) const;
+};
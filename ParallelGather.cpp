@@ -0,0 +1,87 @@
+#include "ParallelGather.h"
+#include <algorithm>
+#include <cassert>
+
+#include "Config.h"
+#include "Effect.h"
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+ParallelGather::ParallelGather(WorkerPool& workers) : _workers(workers) {
+
+	_pools.resize(maxEffectsCount);
+	_counts.resize(maxEffectsCount);
+	_offsets.resize(maxEffectsCount);
+}
+
+unsigned ParallelGather::GetWorkersCount() const {
+	return _workers.GetWorkersCount();
+}
+
+void ParallelGather::copyEffects(unsigned) {
+
+	const auto& effects = *_effects;
+	const unsigned effectsCount = static_cast<unsigned>(effects.size());
+
+	for (unsigned ind = _nextEffect++; ind < effectsCount; ind = _nextEffect++) {
+
+		const ParticlePool* particles = _pools[ind];
+		if (!particles)
+			continue;
+
+		float* instance = _instances + size_t(_offsets[ind]) * instanceFloatsCount;
+		for (unsigned index = 0; index < _counts[ind]; ++index, instance += instanceFloatsCount) {
+			instance[0] = particles->_x[index];
+			instance[1] = particles->_y[index];
+			instance[2] = particles->_age[index];
+			instance[3] = particles->_maxAge[index];
+			instance[4] = particles->_r[index];
+			instance[5] = particles->_g[index];
+			instance[6] = particles->_b[index];
+		}
+
+		effects[ind].RequestSwapParticleBuffer();
+		effects[ind].EndRead();
+	}
+}
+
+unsigned ParallelGather::Gather(const std::vector<Effect>& effects, float* instances, const unsigned maxInstances) {
+
+	PROFILE_ZONE("ParallelGather::Gather");
+
+	assert(effects.size() <= _pools.size());
+
+	_effects = &effects;
+	_instances = instances;
+
+	// pinning and counting is a few loads per effect, done right here instead of waking the workers for it.
+	// Exclusive prefix sum over the counts, effects past maxInstances are cut short
+	unsigned total = 0;
+	_effectsCount = 0;
+
+	for (unsigned ind = 0; ind < effects.size(); ++ind) {
+
+		const Effect& effect = effects[ind];
+		_offsets[ind] = total;
+
+		// pinned until copyEffects is done with it
+		if (!effect.IsAlive() || !effect.BeginRead()) {
+			_pools[ind] = nullptr;
+			_counts[ind] = 0;
+			continue;
+		}
+
+		_pools[ind] = &effect.GetParticles();
+		_counts[ind] = std::min(_pools[ind]->GetCount(), maxInstances - total);
+		total += _counts[ind];
+		++_effectsCount;
+	}
+
+	_nextEffect = 0;
+	_workers.Run(this, &ParallelGather::copyEffects);
+
+	_effects = nullptr;
+	_instances = nullptr;
+
+	return total;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Effect;
+class ParticlePool;
+class WorkerPool;
+
+// Packs the latest snapshot of every live effect into one contiguous instance array on the threads of a WorkerPool:
+// the calling thread pins each effect and takes its live count, an exclusive prefix sum over the counts gives every
+// effect its offset, then the workers copy the effects' particles in parallel. The calling thread works as worker 0.
+// Gather is the renderer's snapshot read, so it must only be called from the one render thread.
+class ParallelGather
+{
+public:
+	// x, y, age, max age, r, g, b per particle
+	static constexpr unsigned instanceFloatsCount = 7;
+
+	explicit ParallelGather(WorkerPool& workers);
+
+	ParallelGather(const ParallelGather&) = delete;
+	ParallelGather& operator=(const ParallelGather&) = delete;
+
+	// writes at most maxInstances particles to instances, returns how many were written
+	unsigned Gather(const std::vector<Effect>& effects, float* instances, unsigned maxInstances);
+
+	unsigned GetWorkersCount() const;
+	// effects gathered by the last call
+	unsigned GetEffectsCount() const { return _effectsCount; }
+
+private:
+	void copyEffects(unsigned workerInd);
+
+	WorkerPool& _workers;
+
+	// effects are handed out one at a time, counts vary too much for fixed shares
+	std::atomic<unsigned> _nextEffect = 0;
+
+	// per effect, valid during one Gather
+	const std::vector<Effect>* _effects = nullptr;
+	std::vector<const ParticlePool*> _pools;
+	std::vector<unsigned> _counts;
+	std::vector<unsigned> _offsets;
+
+	float* _instances = nullptr;
+	unsigned _effectsCount = 0;
+};
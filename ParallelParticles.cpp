@@ -1,12 +1,94 @@
+#include <cstdio>
+#include <cstring>
+
 #include "Renderer.h"
 #include "ParticleSystem.h"
+#include "Profiler.h"
+
+struct GuiOptions
+{
+	RenderMode _renderMode = RenderMode::PerParticle;
+	const char* _tracePath = nullptr;
+	bool _help = false;
+};
+
+static void printUsage(const char* exe) {
+
+	printf("usage: %s [--help] [--render per-particle|instanced] [--trace file]\n", exe);
+	printf("  --render  per-particle issues a draw call for every particle, instanced draws them all with one call,\n");
+	printf("            I switches between them while running, default per-particle\n");
+	printf("  --trace   write a Chrome trace-event JSON on exit, needs a build with PP_ENABLE_PROFILER\n");
+}
+
+static bool parseOptions(const int argc, char** argv, GuiOptions& options) {
+
+	for (int i = 1; i < argc; ++i) {
+
+		const char* arg = argv[i];
+
+		if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+			options._help = true;
+			return true;
+		}
 
-int main()
+		// every other option takes a value
+		if (strcmp(arg, "--render") != 0 && strcmp(arg, "--trace") != 0) {
+			fprintf(stderr, "ERROR: unknown option %s\n", arg);
+			return false;
+		}
+
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!value) {
+			fprintf(stderr, "ERROR: missing value for %s\n", arg);
+			return false;
+		}
+
+		if (strcmp(arg, "--render") == 0) {
+			if (strcmp(value, "per-particle") == 0)
+				options._renderMode = RenderMode::PerParticle;
+			else if (strcmp(value, "instanced") == 0)
+				options._renderMode = RenderMode::Instanced;
+			else {
+				fprintf(stderr, "ERROR: unknown render mode %s\n", value);
+				return false;
+			}
+		}
+		else {
+			options._tracePath = value;
+		}
+
+		++i;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
 {
+	GuiOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	if (options._help) {
+		printUsage(argv[0]);
+		return 0;
+	}
+
+	if (options._tracePath && !Profiler::Start(options._tracePath))
+		fprintf(stderr, "ERROR: profiler is not compiled in, trace disabled\n");
+
 	ParticleSystem system;
 	system.Start();
 
-	Renderer r(&system);
+	Renderer r(&system, options._renderMode);
+
+	system.Stop();
+	system.GetBudget().Print();
+	system.GetPendingExplosions().Print();
+	system.PrintLatency();
+	r.PrintLatency();
 
 	return 0;
 }
@@ -1,47 +1,48 @@
 #include "Particle.h"
 #include <cassert>
-#include "Utils.h"
 #include <cstdint>
 
-#include "Config.h"
+#include "ParticlePool.h"
 
 
-Particle::Particle()
+void Particle::SetPosition(const Vec2F& pos)
 {
+	_pool->_x[_index] = pos._x;
+	_pool->_y[_index] = pos._y;
 }
 
-void Particle::SetPosition(const Vec2F& pos)
+Vec2F Particle::GetPosition() const
 {
-	_info._position = pos;
+	return Vec2F(_pool->_x[_index], _pool->_y[_index]);
 }
 
-void Particle::Deactivate()
+bool Particle::IsAlive() const
 {
-	assert(_isAlive);
-	_isAlive = false;
+	return (_pool->_flags[_index] & ParticleFlagAlive) != 0;
 }
 
-void Particle::Activate()
+bool Particle::GetCanExplode() const
 {
-	assert(!_isAlive);
-	_isAlive = true;
+	return (_pool->_flags[_index] & ParticleFlagCanExplode) != 0;
+}
 
-	_canExplode = rnd01() < particleExplodeProbability;
-	_info._maxLifetime = rndfMinMax(particleMinLifetime, particleMaxLifetime);
-	_info._currLifetime = 0.f;
+void Particle::Deactivate()
+{
+	assert(IsAlive());
+	_pool->_flags[_index] &= ~ParticleFlagAlive;
 }
 
 void Particle::SetSpeed(const Vec2F& speedVec, float speed)
 {
-	_speedVec = speedVec;
-	_speed = speed;
+	_pool->_vx[_index] = speedVec._x * speed;
+	_pool->_vy[_index] = speedVec._y * speed;
 }
 
 void Particle::SetColor(float r, float g, float b)
 {
-	_info._color[0] = r;
-	_info._color[1] = g;
-	_info._color[2] = b;
+	_pool->_r[_index] = r;
+	_pool->_g[_index] = g;
+	_pool->_b[_index] = b;
 }
 
 bool ParticleVisualInfo::GetIsWithinLifetime() const {
@@ -50,15 +51,37 @@ bool ParticleVisualInfo::GetIsWithinLifetime() const {
 }
 
 bool Particle::GetIsWithinLifetime() const {
-	
-	return _info.GetIsWithinLifetime();
+
+	return _pool->_age[_index] < _pool->_maxAge[_index];
+}
+
+ParticleVisualInfo Particle::GetVisualInfo() const
+{
+	ParticleVisualInfo info;
+	info._position = GetPosition();
+	info._currLifetime = _pool->_age[_index];
+	info._maxLifetime = _pool->_maxAge[_index];
+	info._color[0] = _pool->_r[_index];
+	info._color[1] = _pool->_g[_index];
+	info._color[2] = _pool->_b[_index];
+	return info;
+}
+
+double Particle::GetMaxLifetime() const
+{
+	return _pool->_maxAge[_index];
+}
+
+double Particle::GetCurrLifetime() const
+{
+	return _pool->_age[_index];
 }
 
 void Particle::Update(double dt)
 {
-	assert(_isAlive);
-	_info._position._x += _speedVec._x * float(dt) * _speed;
-	_info._position._y += _speedVec._y * float(dt) * _speed;
+	assert(IsAlive());
+	_pool->_x[_index] += _pool->_vx[_index] * float(dt);
+	_pool->_y[_index] += _pool->_vy[_index] * float(dt);
 
-	_info._currLifetime += dt;
-}
\ No newline at end of file
+	_pool->_age[_index] += float(dt);
+}
@@ -29,37 +29,35 @@ struct ParticleVisualInfo {
 	float _color[3] = {1.f, 1.f, 1.f};
 };
 
+class ParticlePool;
+
+// View of a single ParticlePool slot, keeps the old per-particle API on top of the pool arrays
 class Particle
 {
 public:
-	Particle();
+	Particle(ParticlePool& pool, unsigned index) : _pool(&pool), _index(index) {}
 
 	void SetSpeed(const Vec2F& speedVec, float speed);
 
 	void SetPosition(const Vec2F& pos);
-	const Vec2F& GetPosition() const { return _info._position; }
+	Vec2F GetPosition() const;
 
 	void SetColor(float r, float g, float b);
 
 	void Update(double dt);
-	bool IsAlive() const { return _isAlive; }
+	bool IsAlive() const;
 
 	bool GetIsWithinLifetime() const;
-	bool GetCanExplode() const {return _canExplode;}
+	bool GetCanExplode() const;
 
-	const ParticleVisualInfo& GetVisualInfo() const {return _info;}
+	ParticleVisualInfo GetVisualInfo() const;
 
 	void Deactivate();
-	void Activate();
 
-	double GetMaxLifetime() const {return _info._maxLifetime;}
-	double GetCurrLifetime() const { return _info._currLifetime; }
+	double GetMaxLifetime() const;
+	double GetCurrLifetime() const;
 
 private:
-	ParticleVisualInfo _info;
-	Vec2F _speedVec;
-	float _speed = 0.f;
-	bool _canExplode = false;
-
-	bool _isAlive = false;
+	ParticlePool* _pool = nullptr;
+	unsigned _index = 0;
 };
@@ -0,0 +1,83 @@
+#include "ParticleArena.h"
+#include <new>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+static size_t roundUp(const size_t value, const size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+ParticleArena::ParticleArena(const size_t size, const bool hugePages) {
+
+	_size = roundUp(size, hugePageSize);
+
+#if defined(_WIN32)
+	// large pages need SeLockMemoryPrivilege, plain pages are committed on first touch all the same
+	_mappedSize = _size;
+	_memory = static_cast<uint8_t*>(VirtualAlloc(nullptr, _mappedSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+	(void)hugePages;
+#elif defined(__linux__)
+	// map one huge page more than needed so the arena can start on a huge page boundary
+	_mappedSize = _size + hugePageSize;
+	void* mapped = mmap(nullptr, _mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (mapped != MAP_FAILED) {
+		_memory = reinterpret_cast<uint8_t*>(roundUp(reinterpret_cast<uintptr_t>(mapped), hugePageSize));
+
+		const size_t head = _memory - static_cast<uint8_t*>(mapped);
+		if (head > 0)
+			munmap(mapped, head);
+
+		const size_t tail = _mappedSize - head - _size;
+		if (tail > 0)
+			munmap(_memory + _size, tail);
+
+		_mappedSize = _size;
+
+#ifdef MADV_HUGEPAGE
+		if (hugePages)
+			_hugePages = madvise(_memory, _size, MADV_HUGEPAGE) == 0;
+#endif
+	}
+#else
+	(void)hugePages;
+#endif
+
+	if (!_memory) {
+		_mappedSize = 0;
+		_memory = static_cast<uint8_t*>(::operator new(_size, std::align_val_t(hugePageSize)));
+	}
+}
+
+ParticleArena::~ParticleArena() {
+
+	if (_mappedSize == 0) {
+		::operator delete(_memory, std::align_val_t(hugePageSize));
+		return;
+	}
+
+#if defined(_WIN32)
+	VirtualFree(_memory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+	munmap(_memory, _mappedSize);
+#endif
+}
+
+void* ParticleArena::Allocate(const size_t size, const size_t alignment) {
+
+	size_t used = _used.load(std::memory_order_relaxed);
+	size_t offset = 0;
+
+	do {
+		offset = roundUp(used, alignment);
+		if (offset + size > _size)
+			return nullptr;
+	} while (!_used.compare_exchange_weak(used, offset + size, std::memory_order_relaxed));
+
+	return _memory + offset;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// One contiguous reservation that particle buffers are carved from, so all effects share a few (huge) pages
+// instead of hundreds of scattered heap blocks. Pages are committed by the OS on first write, so each one ends up
+// on the NUMA node of the thread that touches it first. Memory is released only when the arena is destroyed.
+class ParticleArena
+{
+public:
+	static constexpr size_t hugePageSize = size_t(2) << 20;
+
+	explicit ParticleArena(size_t size, bool hugePages = true);
+	~ParticleArena();
+
+	ParticleArena(const ParticleArena&) = delete;
+	ParticleArena& operator=(const ParticleArena&) = delete;
+
+	// thread safe bump allocation, returns nullptr once the arena is exhausted
+	void* Allocate(size_t size, size_t alignment);
+
+	size_t GetSize() const { return _size; }
+	size_t GetUsed() const { return _used.load(std::memory_order_relaxed); }
+
+	// true if the OS was asked to back the arena with transparent huge pages
+	bool HasHugePages() const { return _hugePages; }
+
+private:
+	uint8_t* _memory = nullptr;
+	size_t _size = 0;
+	size_t _mappedSize = 0;
+	std::atomic<size_t> _used = 0;
+	bool _hugePages = false;
+};
@@ -0,0 +1,86 @@
+#include "ParticleBlockPool.h"
+#include <cassert>
+
+#include "Effect.h"
+#include "ParticleArena.h"
+#include "ParticlePool.h"
+
+unsigned ParticleBlockPool::GetClassCapacity(const unsigned count) {
+
+	for (const unsigned capacity : classCapacities)
+		if (count <= capacity)
+			return capacity;
+
+	return 0;
+}
+
+size_t ParticleBlockPool::GetBlockSize(const unsigned classCapacity) {
+	return Effect::GetStorageSize(classCapacity);
+}
+
+size_t ParticleBlockPool::GetArenaSize(const unsigned effectsCount, const unsigned maxCapacity) {
+
+	const unsigned maxClassCapacity = GetClassCapacity(maxCapacity);
+	assert(maxClassCapacity != 0);
+
+	size_t size = 0;
+	for (const unsigned capacity : classCapacities)
+		if (capacity <= maxClassCapacity)
+			size += effectsCount * GetBlockSize(capacity);
+
+	return size;
+}
+
+unsigned ParticleBlockPool::classIndex(const unsigned classCapacity) {
+
+	for (unsigned i = 0; i < classesCount; ++i)
+		if (classCapacities[i] == classCapacity)
+			return i;
+
+	assert(false);
+	return 0;
+}
+
+ParticleBlockPool::ParticleBlockPool(ParticleArena& arena) : _arena(arena) {
+}
+
+void* ParticleBlockPool::Acquire(const unsigned classCapacity) {
+
+	auto& sizeClass = _classes[classIndex(classCapacity)];
+	const size_t blockSize = GetBlockSize(classCapacity);
+
+	void* block = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(sizeClass._mutex);
+
+		block = sizeClass._free;
+		if (block)
+			sizeClass._free = *static_cast<void**>(block);
+	}
+
+	// a fresh block is left untouched, its pages get committed by whoever writes particles into it first
+	if (!block)
+		block = _arena.Allocate(blockSize, ParticlePool::alignment);
+
+	if (!block)
+		return nullptr;
+
+	const size_t acquired = _acquiredBytes.fetch_add(blockSize, std::memory_order_relaxed) + blockSize;
+
+	size_t peak = _peakAcquiredBytes.load(std::memory_order_relaxed);
+	while (acquired > peak && !_peakAcquiredBytes.compare_exchange_weak(peak, acquired, std::memory_order_relaxed)) {}
+
+	return block;
+}
+
+void ParticleBlockPool::Release(void* block, const unsigned classCapacity) {
+
+	auto& sizeClass = _classes[classIndex(classCapacity)];
+
+	_acquiredBytes.fetch_sub(GetBlockSize(classCapacity), std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(sizeClass._mutex);
+
+	*static_cast<void**>(block) = sizeClass._free;
+	sizeClass._free = block;
+}
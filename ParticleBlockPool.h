@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+class ParticleArena;
+
+// Size-classed particle storage carved from a ParticleArena. A block holds all per particle storage of an effect
+// (Effect::GetStorageSize) at the class capacity, so an effect only pays for the particles it spawns. Released blocks go to the free
+// list of their class and are reused as they are, never split or merged. Acquire and Release may be called from any thread.
+class ParticleBlockPool
+{
+public:
+	// 512 matches maxParticlesPerEffectCount, so a full effect does not waste half of a 1024 block
+	static constexpr unsigned classesCount = 6;
+	static constexpr unsigned classCapacities[classesCount] = {16, 64, 256, 512, 1024, 4096};
+
+	// capacity of the smallest class fitting count particles, 0 if none does
+	static unsigned GetClassCapacity(unsigned count);
+	static size_t GetBlockSize(unsigned classCapacity);
+
+	// arena bytes that let every one of effectsCount effects hold a block of each class up to maxCapacity at once,
+	// so the arena never runs dry whatever the mix. That reserves about the sum of the class sizes per effect, far
+	// more address space than is ever used at once, but only the pages actually used become resident
+	static size_t GetArenaSize(unsigned effectsCount, unsigned maxCapacity);
+
+	explicit ParticleBlockPool(ParticleArena& arena);
+
+	// returns nullptr if the arena is exhausted
+	void* Acquire(unsigned classCapacity);
+	void Release(void* block, unsigned classCapacity);
+
+	// bytes of blocks currently handed out and the highest that has been
+	size_t GetAcquiredBytes() const { return _acquiredBytes.load(std::memory_order_relaxed); }
+	size_t GetPeakAcquiredBytes() const { return _peakAcquiredBytes.load(std::memory_order_relaxed); }
+
+private:
+	static unsigned classIndex(unsigned classCapacity);
+
+	struct SizeClass
+	{
+		std::mutex _mutex;
+		// released blocks are linked through their first bytes
+		void* _free = nullptr;
+	};
+
+	ParticleArena& _arena;
+	SizeClass _classes[classesCount];
+
+	std::atomic<size_t> _acquiredBytes = 0;
+	std::atomic<size_t> _peakAcquiredBytes = 0;
+};
@@ -0,0 +1,43 @@
+#include "ParticleBudget.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+ParticleBudget::ParticleBudget(const unsigned capacity) : _capacity(capacity) {
+}
+
+unsigned ParticleBudget::Reserve(const unsigned count, const unsigned minCount) {
+
+	assert(minCount <= count);
+
+	unsigned used = _used.load(std::memory_order_relaxed);
+	unsigned granted = 0;
+
+	do {
+		granted = std::min(count, _capacity - used);
+		if (granted == 0 || granted < minCount)
+			return 0;
+	} while (!_used.compare_exchange_weak(used, used + granted, std::memory_order_relaxed));
+
+	unsigned peak = _peakUsed.load(std::memory_order_relaxed);
+	while (used + granted > peak && !_peakUsed.compare_exchange_weak(peak, used + granted, std::memory_order_relaxed)) {}
+
+	return granted;
+}
+
+void ParticleBudget::Release(const unsigned count) {
+
+	assert(count <= GetUsed());
+	_used.fetch_sub(count, std::memory_order_relaxed);
+}
+
+void ParticleBudget::Print() const {
+
+	printf("particle budget %u, peak %u, effects started %llu, shrunk %llu, deferred %llu, evicted %llu, dropped %llu\n",
+		_capacity, GetPeakUsed(),
+		static_cast<unsigned long long>(GetCount(ParticleBudgetOutcome::Started)),
+		static_cast<unsigned long long>(GetCount(ParticleBudgetOutcome::Shrunk)),
+		static_cast<unsigned long long>(GetCount(ParticleBudgetOutcome::Deferred)),
+		static_cast<unsigned long long>(GetCount(ParticleBudgetOutcome::Evicted)),
+		static_cast<unsigned long long>(GetCount(ParticleBudgetOutcome::Dropped)));
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// what the particle system does with an explosion that does not fit the budget, it stays pending whenever it cannot start
+enum class ParticleBudgetPolicy
+{
+	// start it with what is left, down to minParticlesPerEffectCount
+	Shrink,
+	// wait until finished effects hand enough particles back
+	Defer,
+	// stop the oldest running effects to make room and wait until they are gone
+	DropOldest,
+};
+
+enum class ParticleBudgetOutcome
+{
+	Started,
+	Shrunk,
+	// started on a later step than it exploded on
+	Deferred,
+	Evicted,
+	// lost to a full pending explosion queue
+	Dropped,
+	Count,
+};
+
+// Global number of particles all running effects may hold together. Effects reserve their particles before they start
+// and release them once finished, so the total is bounded however the particles are split between effects.
+// Reserve and Release may be called from any thread.
+class ParticleBudget
+{
+public:
+	explicit ParticleBudget(unsigned capacity);
+
+	// grants up to count particles but not less than minCount, returns the granted count or 0
+	unsigned Reserve(unsigned count, unsigned minCount);
+	void Release(unsigned count);
+
+	unsigned GetCapacity() const { return _capacity; }
+	unsigned GetUsed() const { return _used.load(std::memory_order_relaxed); }
+	unsigned GetAvailable() const { return _capacity - GetUsed(); }
+	unsigned GetPeakUsed() const { return _peakUsed.load(std::memory_order_relaxed); }
+
+	void Count(ParticleBudgetOutcome outcome) { _outcomes[static_cast<unsigned>(outcome)].fetch_add(1, std::memory_order_relaxed); }
+	uint64_t GetCount(ParticleBudgetOutcome outcome) const { return _outcomes[static_cast<unsigned>(outcome)].load(std::memory_order_relaxed); }
+
+	void Print() const;
+
+private:
+	const unsigned _capacity;
+	std::atomic<unsigned> _used = 0;
+	std::atomic<unsigned> _peakUsed = 0;
+
+	std::atomic<uint64_t> _outcomes[static_cast<unsigned>(ParticleBudgetOutcome::Count)] = {};
+};
@@ -0,0 +1,315 @@
+#include "ParticleKernels.h"
+#include <cstring>
+#include <initializer_list>
+
+#include "ParticlePool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PP_KERNELS_X86 1
+#include <immintrin.h>
+#else
+#define PP_KERNELS_X86 0
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define PP_TARGET(isa)
+#else
+#define PP_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// every path below must stay a plain multiply followed by an add so that all of them produce the same bits,
+// compilers would otherwise fuse them into fma inside the avx2 and avx512 functions. CMake also builds this file
+// with contraction off, the pragmas cover the Visual Studio project and other builds
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+
+static void clearMasks(const unsigned count, uint64_t* killMask, uint64_t* explodeMask) {
+
+	const unsigned wordsCount = particleMaskWordsCount(count);
+	std::memset(killMask, 0, wordsCount * sizeof(uint64_t));
+	std::memset(explodeMask, 0, wordsCount * sizeof(uint64_t));
+}
+
+template<bool checkLifetime>
+static void stepParticlesRange(ParticlePool& pool, const unsigned begin, const unsigned end, const float dt, uint64_t* killMask, uint64_t* explodeMask) {
+
+	for (unsigned i = begin; i < end; ++i) {
+
+		const float x = pool._x[i] + pool._vx[i] * dt;
+		const float y = pool._y[i] + pool._vy[i] * dt;
+		const float age = pool._age[i] + dt;
+
+		pool._x[i] = x;
+		pool._y[i] = y;
+		pool._age[i] = age;
+
+		const uint8_t flags = pool._flags[i];
+		const bool alive = (flags & ParticleFlagAlive) != 0;
+		const bool canExplode = (flags & ParticleFlagCanExplode) != 0;
+
+		const bool outOfBounds = x > 1.f || y > 1.f || x < 0.f || y < 0.f;
+		const bool expired = checkLifetime && !(age < pool._maxAge[i]);
+
+		const uint64_t bit = uint64_t(1) << (i & 63);
+
+		if (alive && (outOfBounds || expired))
+			killMask[i >> 6] |= bit;
+
+		if (alive && !outOfBounds && expired && canExplode)
+			explodeMask[i >> 6] |= bit;
+	}
+}
+
+template<bool checkLifetime>
+static void stepParticlesScalar(ParticlePool& pool, const unsigned count, const float dt, uint64_t* killMask, uint64_t* explodeMask) {
+
+	clearMasks(count, killMask, explodeMask);
+	stepParticlesRange<checkLifetime>(pool, 0, count, dt, killMask, explodeMask);
+}
+
+#if PP_KERNELS_X86
+
+template<bool checkLifetime>
+static void stepParticlesSse2(ParticlePool& pool, const unsigned count, const float dt, uint64_t* killMask, uint64_t* explodeMask) {
+
+	clearMasks(count, killMask, explodeMask);
+
+	const __m128 dtV = _mm_set1_ps(dt);
+	const __m128 oneV = _mm_set1_ps(1.f);
+	const __m128 zeroV = _mm_setzero_ps();
+	const __m128i zeroI = _mm_setzero_si128();
+	const __m128i aliveBitV = _mm_set1_epi32(ParticleFlagAlive);
+	const __m128i explodeBitV = _mm_set1_epi32(ParticleFlagCanExplode);
+
+	constexpr unsigned width = 4;
+	const unsigned vectorEnd = count / width * width;
+
+	for (unsigned i = 0; i < vectorEnd; i += width) {
+
+		const __m128 x = _mm_add_ps(_mm_load_ps(pool._x + i), _mm_mul_ps(_mm_load_ps(pool._vx + i), dtV));
+		const __m128 y = _mm_add_ps(_mm_load_ps(pool._y + i), _mm_mul_ps(_mm_load_ps(pool._vy + i), dtV));
+		const __m128 age = _mm_add_ps(_mm_load_ps(pool._age + i), dtV);
+
+		_mm_store_ps(pool._x + i, x);
+		_mm_store_ps(pool._y + i, y);
+		_mm_store_ps(pool._age + i, age);
+
+		int packedFlags = 0;
+		std::memcpy(&packedFlags, pool._flags + i, width);
+		__m128i flags = _mm_cvtsi32_si128(packedFlags);
+		flags = _mm_unpacklo_epi16(_mm_unpacklo_epi8(flags, zeroI), zeroI);
+
+		const __m128 alive = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(flags, aliveBitV), aliveBitV));
+		const __m128 canExplode = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(flags, explodeBitV), explodeBitV));
+
+		const __m128 outOfBounds = _mm_or_ps(
+			_mm_or_ps(_mm_cmpgt_ps(x, oneV), _mm_cmpgt_ps(y, oneV)),
+			_mm_or_ps(_mm_cmplt_ps(x, zeroV), _mm_cmplt_ps(y, zeroV)));
+		const __m128 expired = checkLifetime ? _mm_cmpnlt_ps(age, _mm_load_ps(pool._maxAge + i)) : zeroV;
+
+		const __m128 kill = _mm_and_ps(alive, _mm_or_ps(outOfBounds, expired));
+		const __m128 explode = _mm_and_ps(_mm_andnot_ps(outOfBounds, expired), _mm_and_ps(alive, canExplode));
+
+		killMask[i >> 6] |= uint64_t(_mm_movemask_ps(kill)) << (i & 63);
+		explodeMask[i >> 6] |= uint64_t(_mm_movemask_ps(explode)) << (i & 63);
+	}
+
+	stepParticlesRange<checkLifetime>(pool, vectorEnd, count, dt, killMask, explodeMask);
+}
+
+template<bool checkLifetime>
+PP_TARGET("avx2")
+static void stepParticlesAvx2(ParticlePool& pool, const unsigned count, const float dt, uint64_t* killMask, uint64_t* explodeMask) {
+
+	clearMasks(count, killMask, explodeMask);
+
+	const __m256 dtV = _mm256_set1_ps(dt);
+	const __m256 oneV = _mm256_set1_ps(1.f);
+	const __m256 zeroV = _mm256_setzero_ps();
+	const __m256i aliveBitV = _mm256_set1_epi32(ParticleFlagAlive);
+	const __m256i explodeBitV = _mm256_set1_epi32(ParticleFlagCanExplode);
+
+	constexpr unsigned width = 8;
+	const unsigned vectorEnd = count / width * width;
+
+	for (unsigned i = 0; i < vectorEnd; i += width) {
+
+		const __m256 x = _mm256_add_ps(_mm256_load_ps(pool._x + i), _mm256_mul_ps(_mm256_load_ps(pool._vx + i), dtV));
+		const __m256 y = _mm256_add_ps(_mm256_load_ps(pool._y + i), _mm256_mul_ps(_mm256_load_ps(pool._vy + i), dtV));
+		const __m256 age = _mm256_add_ps(_mm256_load_ps(pool._age + i), dtV);
+
+		_mm256_store_ps(pool._x + i, x);
+		_mm256_store_ps(pool._y + i, y);
+		_mm256_store_ps(pool._age + i, age);
+
+		const __m256i flags = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pool._flags + i)));
+
+		const __m256 alive = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(flags, aliveBitV), aliveBitV));
+		const __m256 canExplode = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(flags, explodeBitV), explodeBitV));
+
+		const __m256 outOfBounds = _mm256_or_ps(
+			_mm256_or_ps(_mm256_cmp_ps(x, oneV, _CMP_GT_OQ), _mm256_cmp_ps(y, oneV, _CMP_GT_OQ)),
+			_mm256_or_ps(_mm256_cmp_ps(x, zeroV, _CMP_LT_OQ), _mm256_cmp_ps(y, zeroV, _CMP_LT_OQ)));
+		const __m256 expired = checkLifetime ? _mm256_cmp_ps(age, _mm256_load_ps(pool._maxAge + i), _CMP_NLT_UQ) : zeroV;
+
+		const __m256 kill = _mm256_and_ps(alive, _mm256_or_ps(outOfBounds, expired));
+		const __m256 explode = _mm256_and_ps(_mm256_andnot_ps(outOfBounds, expired), _mm256_and_ps(alive, canExplode));
+
+		killMask[i >> 6] |= uint64_t(_mm256_movemask_ps(kill)) << (i & 63);
+		explodeMask[i >> 6] |= uint64_t(_mm256_movemask_ps(explode)) << (i & 63);
+	}
+
+	stepParticlesRange<checkLifetime>(pool, vectorEnd, count, dt, killMask, explodeMask);
+}
+
+template<bool checkLifetime>
+PP_TARGET("avx512f")
+static void stepParticlesAvx512(ParticlePool& pool, const unsigned count, const float dt, uint64_t* killMask, uint64_t* explodeMask) {
+
+	clearMasks(count, killMask, explodeMask);
+
+	const __m512 dtV = _mm512_set1_ps(dt);
+	const __m512 oneV = _mm512_set1_ps(1.f);
+	const __m512 zeroV = _mm512_setzero_ps();
+	const __m512i aliveBitV = _mm512_set1_epi32(ParticleFlagAlive);
+	const __m512i explodeBitV = _mm512_set1_epi32(ParticleFlagCanExplode);
+
+	constexpr unsigned width = 16;
+	const unsigned vectorEnd = count / width * width;
+
+	for (unsigned i = 0; i < vectorEnd; i += width) {
+
+		const __m512 x = _mm512_add_ps(_mm512_load_ps(pool._x + i), _mm512_mul_ps(_mm512_load_ps(pool._vx + i), dtV));
+		const __m512 y = _mm512_add_ps(_mm512_load_ps(pool._y + i), _mm512_mul_ps(_mm512_load_ps(pool._vy + i), dtV));
+		const __m512 age = _mm512_add_ps(_mm512_load_ps(pool._age + i), dtV);
+
+		_mm512_store_ps(pool._x + i, x);
+		_mm512_store_ps(pool._y + i, y);
+		_mm512_store_ps(pool._age + i, age);
+
+		// the zero-masking form, gcc warns about the undefined passthrough of the plain one
+		const __m512i flags = _mm512_maskz_cvtepu8_epi32(0xffff, _mm_loadu_si128(reinterpret_cast<const __m128i*>(pool._flags + i)));
+
+		const __mmask16 alive = _mm512_test_epi32_mask(flags, aliveBitV);
+		const __mmask16 canExplode = _mm512_test_epi32_mask(flags, explodeBitV);
+
+		const __mmask16 outOfBounds =
+			_mm512_cmp_ps_mask(x, oneV, _CMP_GT_OQ) | _mm512_cmp_ps_mask(y, oneV, _CMP_GT_OQ) |
+			_mm512_cmp_ps_mask(x, zeroV, _CMP_LT_OQ) | _mm512_cmp_ps_mask(y, zeroV, _CMP_LT_OQ);
+		const __mmask16 expired = checkLifetime ? _mm512_cmp_ps_mask(age, _mm512_load_ps(pool._maxAge + i), _CMP_NLT_UQ) : __mmask16(0);
+
+		const unsigned kill = alive & (outOfBounds | expired);
+		const unsigned explode = alive & canExplode & expired & ~outOfBounds & 0xffffu;
+
+		killMask[i >> 6] |= uint64_t(kill) << (i & 63);
+		explodeMask[i >> 6] |= uint64_t(explode) << (i & 63);
+	}
+
+	stepParticlesRange<checkLifetime>(pool, vectorEnd, count, dt, killMask, explodeMask);
+}
+
+static bool cpuSupports(const ParticleKernelIsa isa) {
+
+#if defined(_MSC_VER) && !defined(__clang__)
+	int regs[4] = {};
+	__cpuid(regs, 0);
+	const int maxLeaf = regs[0];
+
+	__cpuid(regs, 1);
+	const bool sse2 = (regs[3] & (1 << 26)) != 0;
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+	const bool avx = (regs[2] & (1 << 28)) != 0;
+
+	if (isa == ParticleKernelIsa::Sse2)
+		return sse2;
+
+	if (!osxsave || !avx || maxLeaf < 7)
+		return false;
+
+	const unsigned long long xcr0 = _xgetbv(0);
+	const bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+	const bool zmmEnabled = (xcr0 & 0xe6) == 0xe6;
+
+	__cpuidex(regs, 7, 0);
+	const bool avx2 = (regs[1] & (1 << 5)) != 0;
+	const bool avx512f = (regs[1] & (1 << 16)) != 0;
+
+	if (isa == ParticleKernelIsa::Avx2)
+		return avx2 && ymmEnabled;
+
+	return avx512f && zmmEnabled;
+#else
+	__builtin_cpu_init();
+
+	switch (isa) {
+	case ParticleKernelIsa::Sse2: return __builtin_cpu_supports("sse2");
+	case ParticleKernelIsa::Avx2: return __builtin_cpu_supports("avx2");
+	case ParticleKernelIsa::Avx512: return __builtin_cpu_supports("avx512f");
+	default: return true;
+	}
+#endif
+}
+
+#endif
+
+template<bool checkLifetime>
+static ParticleKernel getParticleKernel(const ParticleKernelIsa isa) {
+
+	if (isa == ParticleKernelIsa::Scalar)
+		return &stepParticlesScalar<checkLifetime>;
+
+#if PP_KERNELS_X86
+	if (!cpuSupports(isa))
+		return nullptr;
+
+	switch (isa) {
+	case ParticleKernelIsa::Sse2: return &stepParticlesSse2<checkLifetime>;
+	case ParticleKernelIsa::Avx2: return &stepParticlesAvx2<checkLifetime>;
+	case ParticleKernelIsa::Avx512: return &stepParticlesAvx512<checkLifetime>;
+	default: break;
+	}
+#endif
+
+	return nullptr;
+}
+
+ParticleKernel GetParticleKernel(const ParticleKernelIsa isa, const bool checkLifetime) {
+
+	return checkLifetime ? getParticleKernel<true>(isa) : getParticleKernel<false>(isa);
+}
+
+ParticleKernelIsa GetBestParticleKernelIsa() {
+
+	static const ParticleKernelIsa bestIsa = []() {
+		for (const auto isa : {ParticleKernelIsa::Avx512, ParticleKernelIsa::Avx2, ParticleKernelIsa::Sse2})
+			if (GetParticleKernel(isa))
+				return isa;
+
+		return ParticleKernelIsa::Scalar;
+	}();
+
+	return bestIsa;
+}
+
+const char* GetParticleKernelIsaName(const ParticleKernelIsa isa) {
+
+	switch (isa) {
+	case ParticleKernelIsa::Sse2: return "sse2";
+	case ParticleKernelIsa::Avx2: return "avx2";
+	case ParticleKernelIsa::Avx512: return "avx512";
+	default: return "scalar";
+	}
+}
+
+void StepParticles(ParticlePool& pool, const unsigned count, const float dt, uint64_t* killMask, uint64_t* explodeMask, const bool checkLifetime) {
+
+	static const ParticleKernel kernel = GetParticleKernel(GetBestParticleKernelIsa(), true);
+	static const ParticleKernel boundsOnlyKernel = GetParticleKernel(GetBestParticleKernelIsa(), false);
+
+	(checkLifetime ? kernel : boundsOnlyKernel)(pool, count, dt, killMask, explodeMask);
+}
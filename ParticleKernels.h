@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+class ParticlePool;
+
+enum class ParticleKernelIsa
+{
+	Scalar,
+	Sse2,
+	Avx2,
+	Avx512,
+};
+
+// Integrates positions and lifetimes of the first count slots of the pool and sets one bit per particle
+// in killMask (alive and out of bounds or expired) and explodeMask (alive, within bounds, expired, can explode).
+// Masks hold 64 particles per word, words covering [0, count) are overwritten. Kernels built without the lifetime
+// check only kill particles leaving the square and never explode any, expiry is then tracked elsewhere (TimerWheel).
+using ParticleKernel = void(*)(ParticlePool& pool, unsigned count, float dt, uint64_t* killMask, uint64_t* explodeMask);
+
+ParticleKernelIsa GetBestParticleKernelIsa();
+const char* GetParticleKernelIsaName(ParticleKernelIsa isa);
+
+// returns nullptr when the isa is not supported by the cpu or the build
+ParticleKernel GetParticleKernel(ParticleKernelIsa isa, bool checkLifetime = true);
+
+void StepParticles(ParticlePool& pool, unsigned count, float dt, uint64_t* killMask, uint64_t* explodeMask, bool checkLifetime = true);
+
+inline unsigned particleMaskWordsCount(const unsigned count) {
+	return (count + 63) / 64;
+}
+
+inline unsigned lowestSetBit(const uint64_t bits) {
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index = 0;
+#if defined(_M_X64) || defined(_M_ARM64)
+	_BitScanForward64(&index, bits);
+	return index;
+#else
+	if (_BitScanForward(&index, static_cast<unsigned long>(bits)))
+		return index;
+
+	_BitScanForward(&index, static_cast<unsigned long>(bits >> 32));
+	return index + 32;
+#endif
+#else
+	return static_cast<unsigned>(__builtin_ctzll(bits));
+#endif
+}
+
+inline unsigned highestSetBit(const uint64_t bits) {
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index = 0;
+#if defined(_M_X64) || defined(_M_ARM64)
+	_BitScanReverse64(&index, bits);
+	return index;
+#else
+	if (_BitScanReverse(&index, static_cast<unsigned long>(bits >> 32)))
+		return index + 32;
+
+	_BitScanReverse(&index, static_cast<unsigned long>(bits));
+	return index;
+#endif
+#else
+	return 63u - static_cast<unsigned>(__builtin_clzll(bits));
+#endif
+}
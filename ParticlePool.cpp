@@ -0,0 +1,153 @@
+#include "ParticlePool.h"
+#include <cassert>
+#include <cstring>
+#include <new>
+
+static size_t alignedSize(const size_t size) {
+	return (size + ParticlePool::alignment - 1) / ParticlePool::alignment * ParticlePool::alignment;
+}
+
+ParticlePool::~ParticlePool() {
+	release();
+}
+
+void ParticlePool::release() {
+
+	if (_storage && _ownsStorage)
+		::operator delete(_storage, std::align_val_t(alignment));
+
+	_storage = nullptr;
+	_storageSize = 0;
+	_ownsStorage = false;
+	_capacity = 0;
+	_count = 0;
+}
+
+size_t ParticlePool::GetStorageSize(const unsigned capacity) {
+
+	return floatArraysCount * alignedSize(capacity * sizeof(float)) + alignedSize(capacity * sizeof(uint8_t));
+}
+
+void ParticlePool::Resize(const unsigned capacity) {
+
+	release();
+
+	if (capacity == 0)
+		return;
+
+	const size_t storageSize = GetStorageSize(capacity);
+	void* storage = ::operator new(storageSize, std::align_val_t(alignment));
+	std::memset(storage, 0, storageSize);
+
+	Attach(storage, capacity);
+	_ownsStorage = true;
+}
+
+void ParticlePool::Attach(void* storage, const unsigned capacity) {
+
+	release();
+
+	assert(reinterpret_cast<uintptr_t>(storage) % alignment == 0);
+
+	if (capacity == 0)
+		return;
+
+	const size_t floatArraySize = alignedSize(capacity * sizeof(float));
+
+	float** floatArrays[] = {&_x, &_y, &_vx, &_vy, &_age, &_maxAge, &_r, &_g, &_b};
+	static_assert(sizeof(floatArrays) / sizeof(floatArrays[0]) == floatArraysCount, "floatArraysCount is out of date");
+
+	// nothing is written here, the pages stay untouched until the first particles are spawned into them
+	auto* cursor = static_cast<uint8_t*>(storage);
+	for (auto* floatArray : floatArrays) {
+		*floatArray = reinterpret_cast<float*>(cursor);
+		cursor += floatArraySize;
+	}
+
+	_flags = cursor;
+	_storage = storage;
+	_storageSize = GetStorageSize(capacity);
+	_capacity = capacity;
+}
+
+unsigned ParticlePool::Add(const unsigned count) {
+
+	assert(_count + count <= _capacity);
+
+	const unsigned first = _count;
+	_count += count;
+	return first;
+}
+
+void ParticlePool::Remove(const unsigned index) {
+
+	assert(index < _count);
+	const unsigned last = --_count;
+
+	if (index != last) {
+		_x[index] = _x[last];
+		_y[index] = _y[last];
+		_vx[index] = _vx[last];
+		_vy[index] = _vy[last];
+		_age[index] = _age[last];
+		_maxAge[index] = _maxAge[last];
+		_r[index] = _r[last];
+		_g[index] = _g[last];
+		_b[index] = _b[last];
+		_flags[index] = _flags[last];
+	}
+
+	_flags[last] = 0;
+}
+
+void ParticlePool::Clear() {
+
+	std::memset(_flags, 0, _count);
+	_count = 0;
+}
+
+void ParticlePool::CopyFrom(const ParticlePool& other) {
+
+	assert(_capacity == other._capacity);
+
+	std::memcpy(_vx, other._vx, other._count * sizeof(float));
+	std::memcpy(_vy, other._vy, other._count * sizeof(float));
+
+	CopyVisualFrom(other);
+}
+
+void ParticlePool::CopyVisualFrom(const ParticlePool& other) {
+
+	assert(_capacity >= other._count);
+
+	const auto copyArray = [count = other._count](auto* to, const auto* from) {
+		std::memcpy(to, from, count * sizeof(*from));
+	};
+
+	copyArray(_x, other._x);
+	copyArray(_y, other._y);
+	copyArray(_age, other._age);
+	copyArray(_maxAge, other._maxAge);
+	copyArray(_r, other._r);
+	copyArray(_g, other._g);
+	copyArray(_b, other._b);
+	copyArray(_flags, other._flags);
+
+	// slots the other pool no longer uses must read as dead here too
+	if (_count > other._count)
+		std::memset(_flags + other._count, 0, _count - other._count);
+
+	_count = other._count;
+}
+
+Particle ParticlePool::operator[](const unsigned index) {
+
+	assert(index < _capacity);
+	return Particle(*this, index);
+}
+
+const Particle ParticlePool::operator[](const unsigned index) const {
+
+	assert(index < _capacity);
+	return Particle(const_cast<ParticlePool&>(*this), index);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "Particle.h"
+
+enum ParticleFlags : uint8_t
+{
+	ParticleFlagAlive = 1 << 0,
+	ParticleFlagCanExplode = 1 << 1,
+};
+
+// Structure-of-arrays storage for the particles of one effect. All arrays live in a single
+// allocation and each of them starts on its own cache line, Particle is a view into one slot.
+// Live particles are kept packed in [0, GetCount()), removal moves the last live particle into the hole.
+class ParticlePool
+{
+public:
+	static constexpr size_t alignment = 64;
+
+	ParticlePool() = default;
+	ParticlePool(const ParticlePool&) = delete;
+	ParticlePool& operator=(const ParticlePool&) = delete;
+	~ParticlePool();
+
+	// bytes of storage Resize allocates or Attach expects for the given capacity
+	static size_t GetStorageSize(unsigned capacity);
+
+	// allocates and zeroes own storage
+	void Resize(unsigned capacity);
+	// lays the arrays out over external storage of GetStorageSize(capacity) bytes, aligned to alignment.
+	// The memory is neither cleared nor freed by the pool, slots are only meaningful once added
+	void Attach(void* storage, unsigned capacity);
+	unsigned GetCapacity() const { return _capacity; }
+	unsigned GetCount() const { return _count; }
+
+	// appends count slots and returns the index of the first one
+	unsigned Add(unsigned count = 1);
+	void Remove(unsigned index);
+	void Clear();
+
+	void CopyFrom(const ParticlePool& other);
+	void CopyVisualFrom(const ParticlePool& other);
+
+	Particle operator[](unsigned index);
+	const Particle operator[](unsigned index) const;
+
+	float* _x = nullptr;
+	float* _y = nullptr;
+	float* _vx = nullptr;
+	float* _vy = nullptr;
+	float* _age = nullptr;
+	float* _maxAge = nullptr;
+	float* _r = nullptr;
+	float* _g = nullptr;
+	float* _b = nullptr;
+	uint8_t* _flags = nullptr;
+
+private:
+	static constexpr size_t floatArraysCount = 9;
+
+	void release();
+
+	void* _storage = nullptr;
+	size_t _storageSize = 0;
+	bool _ownsStorage = false;
+	unsigned _capacity = 0;
+	unsigned _count = 0;
+};
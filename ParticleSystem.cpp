@@ -1,14 +1,31 @@
 #include "ParticleSystem.h"
-#include <set>
-#include <random>
+#include <algorithm>
 #include "Config.h"
+#include "Profiler.h"
 #include "Utils.h"
 
-ParticleSystem::ParticleSystem() {
-	_effects.resize(maxEffectsCount);
-
-	for (unsigned i = 0; i < _effects.size(); i++)
+ParticleSystem::ParticleSystem(const unsigned workersCount) :
+	_arena(ParticleBlockPool::GetArenaSize(maxEffectsCount, maxParticlesPerEffectCount), particleArenaHugePages),
+	_particleBlocks(_arena),
+	_budget(maxParticlesCount),
+	_effectBudgets(maxEffectsCount),
+	_unusedEffects(maxEffectsCount),
+	_scheduler(workersCount),
+	_pendingExplosions(maxPendingExplosionsCount)
+{
+	// reserved up front, effects are never copied or moved
+	_effects.reserve(maxEffectsCount);
+
+	for (unsigned i = 0; i < maxEffectsCount; i++) {
+		_effects.emplace_back(&_particleBlocks);
 		_effects[i]._num = i;
+	}
+
+	_scheduler.SetEffectFinishedCallback([this](Effect& effect) {
+		_budget.Release(_effectBudgets[effect._num]._particlesCount);
+		_unusedEffects.Release(effect._num);
+	});
+
 }
 
 ParticleSystem::~ParticleSystem() {
@@ -19,15 +36,29 @@ const std::vector<Effect>& ParticleSystem::GetEffects() const {
 	return _effects;
 }
 
+const EffectScheduler& ParticleSystem::GetScheduler() const {
+	return _scheduler;
+}
+
+void ParticleSystem::SetTimeScale(const double timeScale) {
+
+	_timeScale = particleSystemTimeScale * timeScale;
+	_scheduler.SetTimeScale(effectSimTimeScale * timeScale);
+}
+
 void ParticleSystem::start() {
 
+	PROFILE_THREAD_NAME("particle system");
+
 	const Vec2F startPos(0.5f, 0.5f);
 
-	for(unsigned effInd = 0; effInd < maxEffectsCount; ++effInd)
-		addToUnusedEffects(effInd);
+	_random.Seed(GetRandomSeed());
 
-	auto* initialEffect = aquireUnusedEffect();
-	initialEffect->Start(startPos);
+	_scheduler.Start();
+
+	_updateStep = 0;
+	queueExplosion(startPos, 0);
+	admitPendingExplosions();
 
 	_prevUpdateTime = getTime();
 	_timeVault = 0;
@@ -37,7 +68,7 @@ void ParticleSystem::start() {
 		const auto currTime = getTime();
 		const auto dt = currTime - _prevUpdateTime;
 
-		_timeVault += dt * particleSystemTimeScale;
+		_timeVault += dt * _timeScale;
 		_prevUpdateTime = currTime;
 
 		if (_timeVault < particleSystemTimeStep) {
@@ -47,11 +78,20 @@ void ParticleSystem::start() {
 			continue;
 		}
 		
+		_latency._wakeupDelay.Record(static_cast<uint64_t>((_timeVault - particleSystemTimeStep) / _timeScale * 1e9));
+
+		unsigned steps = 0;
 		while (_timeVault >= particleSystemTimeStep && !_stopRequested)
 		{
 			_timeVault -= particleSystemTimeStep;
+
+			const uint64_t stepStart = getTimeNs();
 			update();
-		}		
+			_latency._stepTime.Record(getTimeNs() - stepStart);
+			++steps;
+		}
+
+		_latency._catchUpSteps.Record(steps);		
 	}
 
 	stop();
@@ -64,14 +104,12 @@ void ParticleSystem::Start() {
 
 Effect* ParticleSystem::aquireUnusedEffect() {
 
-	if (!_unusedEffectsSet.empty()) {
-		
-		const auto ind = *_unusedEffectsSet.begin();
-		_unusedEffectsSet.erase(_unusedEffectsSet.begin());
+	unsigned ind = 0;
+	if (_unusedEffects.Acquire(ind)) {
 		Effect* effect = &_effects[ind];
 		return effect;
 	}
-	
+
 	return nullptr;
 }
 
@@ -84,66 +122,164 @@ void ParticleSystem::Stop() {
 
 void ParticleSystem::stop() {
 
-	for (auto& effect : _effects)
-		effect.RequestThreadStop();
+	_scheduler.Stop();
+}
+
+bool ParticleSystem::startEffect(Effect* effect, const Vec2F& pos, const unsigned particlesCount) {
+
+	if (!effect->Start(pos, _random.Next(), particlesCount, _motionMode)) {
+		_unusedEffects.Release(effect->_num);
+		return false;
+	}
+
+	_scheduler.Schedule(effect);
+	return true;
+}
+
+bool ParticleSystem::tryStartEffect(const Vec2F& pos, const unsigned particlesCount, const unsigned minCount) {
+
+	const unsigned granted = _budget.Reserve(particlesCount, minCount);
+	if (granted == 0)
+		return false;
+
+	auto* effect = aquireUnusedEffect();
+	if (!effect) {
+		_budget.Release(granted);
+		return false;
+	}
+
+	auto& effectBudget = _effectBudgets[effect->_num];
+	effectBudget._particlesCount = granted;
+	effectBudget._startStep = _updateStep;
+	effectBudget._evicted = false;
+
+	if (!startEffect(effect, pos, granted)) {
+		_budget.Release(granted);
+		return false;
+	}
+
+	_budget.Count(ParticleBudgetOutcome::Started);
+	if (granted < particlesCount)
+		_budget.Count(ParticleBudgetOutcome::Shrunk);
+
+	return true;
+}
+
+void ParticleSystem::queueExplosion(const Vec2F& pos, const uint64_t tick) {
+
+	PendingExplosion explosion;
+	explosion._position = pos;
+	explosion._particlesCount = _random.NextMinMax(1, maxParticlesPerEffectCount);
+	explosion._tick = tick;
+	explosion._systemStep = _updateStep;
 
-	for (auto& effect : _effects)
-		effect.DetachThread();
+	if (!_pendingExplosions.Push(explosion))
+		_budget.Count(ParticleBudgetOutcome::Dropped);
+}
+
+void ParticleSystem::admitPendingExplosions() {
+
+	while (!_pendingExplosions.Empty()) {
+
+		const auto& next = _pendingExplosions.Front();
+
+		const unsigned minCount = _budgetPolicy == ParticleBudgetPolicy::Shrink ?
+			std::min(next._particlesCount, minParticlesPerEffectCount) : next._particlesCount;
+
+		if (!tryStartEffect(next._position, next._particlesCount, minCount)) {
+			if (_budgetPolicy == ParticleBudgetPolicy::DropOldest)
+				evictOldestEffects(next._particlesCount);
+			break;
+		}
+
+		if (next._systemStep != _updateStep)
+			_budget.Count(ParticleBudgetOutcome::Deferred);
+
+		_pendingExplosions.Pop();
+	}
+}
+
+void ParticleSystem::evictOldestEffects(const unsigned particlesCount) {
+
+	unsigned stoppingParticles = 0;
+	bool slotStopping = false;
+
+	for (auto& effect : _effects) {
+		const auto& effectBudget = _effectBudgets[effect._num];
+		if (effectBudget._evicted && effect.IsScheduled()) {
+			stoppingParticles += effectBudget._particlesCount;
+			slotStopping = true;
+		}
+	}
+
+	while (_budget.GetAvailable() + stoppingParticles < particlesCount || (_unusedEffects.GetFreeCount() == 0 && !slotStopping)) {
+
+		Effect* oldest = nullptr;
+		for (auto& effect : _effects) {
+			if (!effect.IsAlive() || _effectBudgets[effect._num]._evicted)
+				continue;
+
+			if (!oldest || _effectBudgets[effect._num]._startStep < _effectBudgets[oldest->_num]._startStep)
+				oldest = &effect;
+		}
+
+		if (!oldest)
+			break;
+
+		auto& oldestBudget = _effectBudgets[oldest->_num];
+		oldestBudget._evicted = true;
+		oldest->RequestStop();
+
+		stoppingParticles += oldestBudget._particlesCount;
+		slotStopping = true;
+		_budget.Count(ParticleBudgetOutcome::Evicted);
+	}
 }
 
 void ParticleSystem::SoftStop() {
 	_stopExplode = true;
 }
 
-bool ParticleSystem::addToUnusedEffects(const unsigned index) {
+void ParticleSystem::PrintLatency() const {
 
-	_unusedEffectsSet.insert(index);
-	return true;
+	_scheduler.PrintLatency();
+	_latency.Print("particle system");
+}
+
+const SlotAllocator& ParticleSystem::GetEffectSlots() const {
+	return _unusedEffects;
 }
 
 void ParticleSystem::update() {
 
+	PROFILE_ZONE("ParticleSystem::update");
+
 	//printf("ParticleSystem::update\n");
 
-	std::vector<Vec2F> explodePosVec;
+	++_updateStep;
 
 	for(unsigned effectIndex = 0; effectIndex < _effects.size(); ++effectIndex) {
 
 		Effect& effect = _effects.at(effectIndex);
 
+		// an effect only dies once its ring is drained, after that the clock thread may hand its storage back
 		if (!effect.IsAlive())
-		{
-			if (!effect.IsThreadRunning())
-			{
-				addToUnusedEffects(effectIndex);
-				continue;
-			}
-		}
+			continue;
 
-		const auto& exploded = effect.GetExploded();
-		for (const auto& exlodedPos : exploded)
-			explodePosVec.push_back(exlodedPos);
+		// rings are drained even after SoftStop, effects wait for that before they finish
+		effect.ConsumeExploded([this](const ExplosionEvent& event) {
+			if (!_stopExplode)
+				queueExplosion(event._position, event._tick);
+		});
 	}
 
-	if (_stopExplode) {
-		explodePosVec.clear();
-	}
+	if (_stopExplode)
+		_pendingExplosions.Clear();
 
-	std::shuffle(explodePosVec.begin(), explodePosVec.end(), std::default_random_engine());	
-
-	for (const auto& explodePos : explodePosVec) {
-		auto* newEffect = aquireUnusedEffect();
-			
-		if (newEffect) {
-			//printf("ParticleSystem::update unused effect found %i, will activate now \n", newEffect->_num);
-			
-			newEffect->Start(explodePos);
-		} else {
-			// sorry, limit reached
-		}
-	}
+	admitPendingExplosions();
+	_pendingExplosions.RecordDepth();
 
-	if (_unusedEffectsSet.size() == maxEffectsCount) {
+	if (_unusedEffects.GetFreeCount() == maxEffectsCount && _pendingExplosions.Empty()) {
 		_stopRequested = true;
 	}
 }
@@ -1,11 +1,17 @@
 #pragma once
-#include <set>
 #include "Effect.h"
+#include "EffectScheduler.h"
+#include "ExplosionQueue.h"
+#include "ParticleArena.h"
+#include "ParticleBlockPool.h"
+#include "ParticleBudget.h"
+#include "SlotAllocator.h"
 
 class ParticleSystem
 {
 public:
-	ParticleSystem();
+	// workersCount 0 means one effect worker per hardware thread
+	explicit ParticleSystem(unsigned workersCount = 0);
 	~ParticleSystem();
 
 	void Start();
@@ -13,25 +19,84 @@ public:
 	void Stop();
 	void SoftStop();
 
+	// multiplies both the system and the effect clocks, set before Start
+	void SetTimeScale(double timeScale);
+
+	// applies to effects started afterwards
+	void SetMotionMode(ParticleMotionMode motionMode) { _motionMode = motionMode; }
+
+	// decides what happens to explosions that do not fit the particle budget, set before Start
+	void SetBudgetPolicy(ParticleBudgetPolicy policy) { _budgetPolicy = policy; }
+	ParticleBudgetPolicy GetBudgetPolicy() const { return _budgetPolicy; }
+
+	// order pending explosions are started in, set before Start
+	void SetAdmissionPolicy(ExplosionAdmissionPolicy policy) { _pendingExplosions.SetPolicy(policy); }
+	ExplosionAdmissionPolicy GetAdmissionPolicy() const { return _pendingExplosions.GetPolicy(); }
+
+	// set once every effect has died out or Stop was called
+	bool IsStopRequested() const { return _stopRequested; }
+
 	const std::vector<Effect>& GetEffects() const;
+	const SlotAllocator& GetEffectSlots() const;
+	const EffectScheduler& GetScheduler() const;
+	const ParticleArena& GetArena() const { return _arena; }
+	const ParticleBlockPool& GetParticleBlocks() const { return _particleBlocks; }
+	const ParticleBudget& GetBudget() const { return _budget; }
+	const ExplosionQueue& GetPendingExplosions() const { return _pendingExplosions; }
+
+	const LoopLatency& GetLatency() const { return _latency; }
+	// system and effect loop latencies so far, may be called while running
+	void PrintLatency() const;
 
 protected:
+	friend class Benchmark;
+
 	Effect* aquireUnusedEffect();
 	void start();
 	void update();
 	void stop();
 
-	bool addToUnusedEffects(unsigned);
+	// hands the slot back if the effect could not get particle storage
+	bool startEffect(Effect* effect, const Vec2F& pos, unsigned particlesCount);
+
+	// takes a slot and at least minCount of particlesCount particles from the budget, false if either is missing
+	bool tryStartEffect(const Vec2F& pos, unsigned particlesCount, unsigned minCount);
+	void queueExplosion(const Vec2F& pos, uint64_t tick);
+	// starts pending explosions in admission order until one does not fit, the rest wait for a later step
+	void admitPendingExplosions();
+	// stops the oldest running effects until those already stopping free a slot and particlesCount particles
+	void evictOldestEffects(unsigned particlesCount);
 
 private:
+	// budget share of an effect slot, set when it starts and handed back when it finishes
+	struct EffectBudget
+	{
+		unsigned _particlesCount = 0;
+		uint64_t _startStep = 0;
+		bool _evicted = false;
+	};
+
+	ParticleArena _arena;
+	ParticleBlockPool _particleBlocks;
+	ParticleBudget _budget;
 	std::vector<Effect> _effects;
-	std::set<unsigned> _unusedEffectsSet;
+	std::vector<EffectBudget> _effectBudgets;
+	SlotAllocator _unusedEffects;
+	EffectScheduler _scheduler;
+	ExplosionQueue _pendingExplosions;
+	ParticleBudgetPolicy _budgetPolicy = ParticleBudgetPolicy::Shrink;
+	uint64_t _updateStep = 0;
+	Random _random;
 
 	std::atomic<bool> _stopExplode = false;
+	std::atomic<ParticleMotionMode> _motionMode = ParticleMotionMode::Integrated;
 
+	double _timeScale = particleSystemTimeScale;
 	double _timeVault = 0.f;
 	double _prevUpdateTime = 0.f;
 
+	LoopLatency _latency;
+
 	std::thread _thread;
 	std::atomic<bool> _stopRequested = false;
 };
@@ -0,0 +1,186 @@
+#include "Profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+
+std::atomic<bool> Profiler::_recording = false;
+
+#ifdef PP_ENABLE_PROFILER
+
+namespace {
+
+struct TraceEvent
+{
+	const char* _name;
+	uint64_t _start;
+	uint64_t _end;
+};
+
+// written by its own thread only, _count is published after the event so the dump never sees a half written one
+struct ThreadTrace
+{
+	static constexpr unsigned capacity = 1 << 16;
+
+	std::unique_ptr<TraceEvent[]> _events = std::make_unique<TraceEvent[]>(capacity);
+	std::atomic<unsigned> _count = 0;
+	std::atomic<uint64_t> _dropped = 0;
+
+	unsigned _tid = 0;
+	char _name[32] = {};
+	std::atomic<bool> _hasName = false;
+
+	ThreadTrace* _next = nullptr;
+};
+
+// traces are never freed, threads may record until the very end of the process
+std::atomic<ThreadTrace*> threadTraces = nullptr;
+std::atomic<unsigned> threadTracesCount = 0;
+
+std::string outputPath;
+uint64_t startTime = 0;
+std::mutex controlMutex;
+bool started = false;
+bool dumped = false;
+
+ThreadTrace& threadTrace() {
+
+	thread_local ThreadTrace* trace = nullptr;
+
+	if (!trace) {
+		trace = new ThreadTrace();
+		trace->_tid = ++threadTracesCount;
+
+		ThreadTrace* head = threadTraces.load(std::memory_order_relaxed);
+		do {
+			trace->_next = head;
+		} while (!threadTraces.compare_exchange_weak(head, trace, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	return *trace;
+}
+
+void dumpTrace() {
+
+	FILE* file = fopen(outputPath.c_str(), "w");
+	if (!file) {
+		fprintf(stderr, "ERROR: cannot write trace to %s\n", outputPath.c_str());
+		return;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"ParallelParticles\"}}");
+
+	uint64_t eventsCount = 0;
+	uint64_t droppedCount = 0;
+
+	for (ThreadTrace* trace = threadTraces.load(std::memory_order_acquire); trace; trace = trace->_next) {
+
+		if (trace->_hasName.load(std::memory_order_acquire))
+			fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", trace->_tid, trace->_name);
+
+		const unsigned count = trace->_count.load(std::memory_order_acquire);
+		for (unsigned i = 0; i < count; ++i) {
+
+			const auto& event = trace->_events[i];
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				event._name, trace->_tid, (event._start - startTime) / 1000.0, (event._end - event._start) / 1000.0);
+		}
+
+		eventsCount += count;
+		droppedCount += trace->_dropped.load(std::memory_order_relaxed);
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	printf("trace: %llu zones written to %s", static_cast<unsigned long long>(eventsCount), outputPath.c_str());
+	if (droppedCount > 0)
+		printf(", %llu dropped on full thread buffers", static_cast<unsigned long long>(droppedCount));
+	printf("\n");
+}
+
+}
+
+bool Profiler::Start(const char* path) {
+
+	std::lock_guard<std::mutex> lock(controlMutex);
+
+	if (started)
+		return false;
+
+	started = true;
+	outputPath = path;
+	startTime = Now();
+	std::atexit(Profiler::Stop);
+
+	_recording = true;
+	return true;
+}
+
+void Profiler::Stop() {
+
+	std::lock_guard<std::mutex> lock(controlMutex);
+
+	_recording = false;
+
+	if (!started || dumped)
+		return;
+
+	dumped = true;
+	dumpTrace();
+}
+
+void Profiler::SetThreadName(const char* name, const int index) {
+
+	auto& trace = threadTrace();
+
+	if (index >= 0)
+		snprintf(trace._name, sizeof(trace._name), "%s %d", name, index);
+	else
+		snprintf(trace._name, sizeof(trace._name), "%s", name);
+
+	trace._hasName.store(true, std::memory_order_release);
+}
+
+void Profiler::Record(const char* name, const uint64_t start, const uint64_t end) {
+
+	if (!IsRecording())
+		return;
+
+	auto& trace = threadTrace();
+
+	const unsigned count = trace._count.load(std::memory_order_relaxed);
+	if (count == ThreadTrace::capacity) {
+		trace._dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	trace._events[count] = TraceEvent{name, start, end};
+	trace._count.store(count + 1, std::memory_order_release);
+}
+
+#else
+
+bool Profiler::Start(const char*) {
+	return false;
+}
+
+void Profiler::Stop() {
+}
+
+void Profiler::SetThreadName(const char*, int) {
+}
+
+void Profiler::Record(const char*, uint64_t, uint64_t) {
+}
+
+#endif
+
+uint64_t Profiler::Now() {
+
+	const auto sinceEpoch = std::chrono::steady_clock::now().time_since_epoch();
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch).count());
+}
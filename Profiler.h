@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Scoped trace zones, written out as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+// Every thread records into its own preallocated buffer without locks, the buffers are only read when the trace is dumped.
+// Zones compile to nothing unless PP_ENABLE_PROFILER is defined, and record nothing until Profiler::Start.
+class Profiler
+{
+public:
+	// starts recording, the trace is written to outputPath by Stop or at exit. Returns false if compiled out or already started
+	static bool Start(const char* outputPath);
+	static void Stop();
+
+	// label of the calling thread's track, copied. A non-negative index is appended to the name
+	static void SetThreadName(const char* name, int index = -1);
+
+	static bool IsRecording() { return _recording.load(std::memory_order_relaxed); }
+
+	static uint64_t Now();
+
+	// name must outlive the trace, string literals only
+	static void Record(const char* name, uint64_t start, uint64_t end);
+
+private:
+	static std::atomic<bool> _recording;
+};
+
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name) : _name(name), _start(Profiler::IsRecording() ? Profiler::Now() : 0) {}
+
+	~ProfileZone() {
+		if (_start != 0)
+			Profiler::Record(_name, _start, Profiler::Now());
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* _name;
+	uint64_t _start;
+};
+
+#ifdef PP_ENABLE_PROFILER
+#define PP_PROFILE_CONCAT_IMPL(a, b) a##b
+#define PP_PROFILE_CONCAT(a, b) PP_PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) ProfileZone PP_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD_NAME(...) Profiler::SetThreadName(__VA_ARGS__)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD_NAME(...) ((void)0)
+#endif
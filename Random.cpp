@@ -0,0 +1,126 @@
+#include "Random.h"
+#include <atomic>
+#include <random>
+
+static std::atomic<uint64_t>& randomSeed() {
+	static std::atomic<uint64_t> seed(std::random_device{}());
+	return seed;
+}
+
+static uint64_t splitMix64(uint64_t& state) {
+
+	uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(const uint64_t x, const int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline float toFloat01(const uint64_t x) {
+	// top 24 bits fill the float mantissa exactly, result is in [0, 1)
+	return static_cast<float>(x >> 40) * (1.f / 16777216.f);
+}
+
+Random::Random(const uint64_t seed) {
+	Seed(seed);
+}
+
+void Random::Seed(uint64_t seed) {
+
+	for (unsigned lane = 0; lane < lanesCount; ++lane)
+		for (auto& word : _state)
+			word[lane] = splitMix64(seed);
+
+	_bufferPos = lanesCount;
+}
+
+void Random::nextBlock(uint64_t* out) {
+
+	auto& s0 = _state[0];
+	auto& s1 = _state[1];
+	auto& s2 = _state[2];
+	auto& s3 = _state[3];
+
+	for (unsigned lane = 0; lane < lanesCount; ++lane) {
+
+		out[lane] = rotl(s0[lane] + s3[lane], 23) + s0[lane];
+
+		const uint64_t t = s1[lane] << 17;
+
+		s2[lane] ^= s0[lane];
+		s3[lane] ^= s1[lane];
+		s1[lane] ^= s2[lane];
+		s0[lane] ^= s3[lane];
+
+		s2[lane] ^= t;
+		s3[lane] = rotl(s3[lane], 45);
+	}
+}
+
+uint64_t Random::Next() {
+
+	if (_bufferPos == lanesCount) {
+		nextBlock(_buffer);
+		_bufferPos = 0;
+	}
+
+	return _buffer[_bufferPos++];
+}
+
+float Random::Next01() {
+	return toFloat01(Next());
+}
+
+unsigned Random::NextMinMax(const unsigned min, const unsigned max) {
+
+	const uint64_t range = static_cast<uint64_t>(max - min) + 1;
+	return min + static_cast<unsigned>(Next() % range);
+}
+
+void Random::Fill01(float* out, const unsigned count) {
+
+	unsigned i = 0;
+	uint64_t block[lanesCount];
+
+	for (; i + lanesCount <= count; i += lanesCount) {
+		nextBlock(block);
+		for (unsigned lane = 0; lane < lanesCount; ++lane)
+			out[i + lane] = toFloat01(block[lane]);
+	}
+
+	for (; i < count; ++i)
+		out[i] = Next01();
+}
+
+void Random::FillMinMax(float* out, const unsigned count, const float min, const float max) {
+
+	Fill01(out, count);
+
+	const float range = max - min;
+	for (unsigned i = 0; i < count; ++i)
+		out[i] = min + out[i] * range;
+}
+
+void SetRandomSeed(const uint64_t seed) {
+	randomSeed() = seed;
+}
+
+uint64_t GetRandomSeed() {
+	return randomSeed();
+}
+
+uint64_t MixSeed(uint64_t seed, const uint64_t stream) {
+
+	seed ^= splitMix64(seed) + stream * 0xd1342543de82ef95ull;
+	return splitMix64(seed);
+}
+
+Random& ThreadRandom() {
+
+	static std::atomic<uint64_t> threadsCount(0);
+	thread_local Random random(MixSeed(GetRandomSeed(), threadsCount++));
+	return random;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+
+// xoshiro256++ generator running lanesCount independent streams side by side, so filling arrays
+// compiles to vector code instead of one serial dependency chain. Not thread safe: use one instance per thread or effect.
+class Random
+{
+public:
+	static constexpr unsigned lanesCount = 8;
+
+	explicit Random(uint64_t seed = 0);
+
+	void Seed(uint64_t seed);
+
+	uint64_t Next();
+	float Next01();
+	unsigned NextMinMax(unsigned min, unsigned max);
+
+	void Fill01(float* out, unsigned count);
+	void FillMinMax(float* out, unsigned count, float min, float max);
+
+private:
+	void nextBlock(uint64_t* out);
+
+	uint64_t _state[4][lanesCount] = {};
+
+	uint64_t _buffer[lanesCount] = {};
+	unsigned _bufferPos = lanesCount;
+};
+
+// base seed every stream is derived from, set it before the simulation starts for reproducible runs
+void SetRandomSeed(uint64_t seed);
+uint64_t GetRandomSeed();
+
+uint64_t MixSeed(uint64_t seed, uint64_t stream);
+
+// stream private to the calling thread
+Random& ThreadRandom();
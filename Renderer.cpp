@@ -1,12 +1,15 @@
 #include "Renderer.h"
+#include <algorithm>
 #include <cstdio>
 #include <string>
+#include <thread>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include "Config.h"
 #include "ParticleSystem.h"
+#include "Profiler.h"
 #include "Utils.h"
 
 constexpr float fpsUpdateInterval = 4.f;
@@ -28,7 +31,17 @@ void windowSizeCB(GLFWwindow* window, int x, int y)
 		renderer->SetSize(x, y);
 }
 
-Renderer::Renderer(ParticleSystem* system) : _particleSystem(system) {
+static constexpr unsigned instanceFloatsCount = ParallelGather::instanceFloatsCount;
+static constexpr unsigned maxInstancesCount = maxEffectsCount * maxParticlesPerEffectCount;
+
+static const char* getRenderModeName(const RenderMode renderMode) {
+	return renderMode == RenderMode::Instanced ? "instanced" : "per particle";
+}
+
+Renderer::Renderer(ParticleSystem* system, const RenderMode renderMode)
+	: _gatherWorkers(WorkerPool::GetSpareWorkersCount(system->GetScheduler().GetWorkersCount()), "render gather"),
+	_gather(_gatherWorkers), _particleSystem(system) {
+	_renderMode = renderMode;
 	init();
 }
 
@@ -57,8 +70,20 @@ void Renderer::updateFPS()
 	{
 		_previousFPSTime = currentTime;
 		const double fps = static_cast<double>(_frameCount) / elapsed;
-		char txtBuf[128];
-		sprintf_s(txtBuf, "opengl @ fps: %.2f, particles %u effects %u", fps, _particlesRendered, _effectsRendered);
+		char txtBuf[256];
+
+		// averaged over the instanced frames of the interval
+		const double instancedFrames = std::max(_instancedFrames, 1u);
+		const double uploadKb = _instanceStream.GetUploadBytes() / instancedFrames / 1024.0;
+		const double fenceWaitMs = _instanceStream.GetFenceWaitNs() / instancedFrames * 1e-6;
+
+		snprintf(txtBuf, sizeof(txtBuf),
+			"opengl @ fps: %.2f, %s, frame %.2f ms, draw calls %u, particles %u effects %u, upload %.1f KB/frame (%s), fence wait %.3f ms",
+			fps, getRenderModeName(_renderMode), _lastFrameTime * 1000.0, _drawCalls, _particlesRendered, _effectsRendered,
+			uploadKb, _instanceStream.IsPersistent() ? "persistent" : "orphaning", fenceWaitMs);
+
+		_instanceStream.ResetStats();
+		_instancedFrames = 0;
 		glfwSetWindowTitle(_window, txtBuf);
 		_frameCount = 0;
 	}
@@ -66,19 +91,28 @@ void Renderer::updateFPS()
 	++_frameCount;
 }
 
+// scale shrinks over the last fadeoutTime seconds of a particle's life, expired particles are drawn tiny.
+// Scene position [0, 1] maps to clip space [-1, 1]
+#define PARTICLE_VERTEX_GLSL \
+	"uniform float baseScale;" \
+	"uniform float fadeoutTime;" \
+	"const float zeroScale = 0.001;" \
+	"vec4 particleVertex(vec3 vp, vec2 position, vec2 lifetime) {" \
+	"float remaining = lifetime.y - lifetime.x;" \
+	"float scale = remaining > 0.0 ? baseScale * max(min(remaining / fadeoutTime, 1.0), zeroScale) : zeroScale;" \
+	"return vec4(vp.xy * scale + 2.0 * (position - 0.5), vp.z, 1.0);" \
+	"}"
+
 const char* getVerterShader() {
 	
 	static const char* shaderStr =
 		"#version 400\n"
+		PARTICLE_VERTEX_GLSL
 		"in vec3 vp;"
-		"uniform float scale;"
-		"uniform vec2 offset;"
-		"out vec3 color;"
+		"uniform vec2 position;"
+		"uniform vec2 lifetime;"
 		"void main() {"
-		"vec4 position = vec4(vp, 1.0);"
-		"position[0] = position[0] * scale + offset[0];"
-		"position[1] = position[1] * scale + offset[1];"
-		"gl_Position = position;"
+		"gl_Position = particleVertex(vp, position, lifetime);"
 		"}";
 
 	return shaderStr;
@@ -98,6 +132,84 @@ const char* getFragmentShader()
 	return fragmentStr;
 }
 
+// same triangle as the per particle shader, position, lifetime and color come from the instance buffer
+const char* getInstancedVertexShader() {
+
+	static const char* shaderStr =
+		"#version 400\n"
+		PARTICLE_VERTEX_GLSL
+		"layout(location = 0) in vec3 vp;"
+		"layout(location = 1) in vec2 position;"
+		"layout(location = 2) in vec2 lifetime;"
+		"layout(location = 3) in vec3 instanceColor;"
+		"out vec3 color;"
+		"void main() {"
+		"color = instanceColor;"
+		"gl_Position = particleVertex(vp, position, lifetime);"
+		"}";
+
+	return shaderStr;
+}
+
+const char* getInstancedFragmentShader()
+{
+	static const char* fragmentStr =
+		"#version 400\n"
+		"uniform float alpha;"
+		"in vec3 color;"
+		"out vec4 frag_color;"
+		"void main() {"
+		"frag_color = vec4(color, alpha);"
+		"}";
+
+	return fragmentStr;
+}
+
+unsigned Renderer::createProgram(const char* vertexShader, const char* fragmentShader) {
+
+	const GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vs, 1, &vertexShader, nullptr);
+	glCompileShader(vs);
+
+	const GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fs, 1, &fragmentShader, nullptr);
+	glCompileShader(fs);
+
+	const GLuint program = glCreateProgram();
+	glAttachShader(program, fs);
+	glAttachShader(program, vs);
+	glLinkProgram(program);
+
+	glUseProgram(program);
+	glUniform1f(glGetUniformLocation(program, "baseScale"), particleScaleDefault);
+	glUniform1f(glGetUniformLocation(program, "fadeoutTime"), static_cast<float>(particleFadeoutTime));
+
+	return program;
+}
+
+void Renderer::initInstancing() {
+
+	_instanceStream.Init(size_t(maxInstancesCount) * instanceFloatsCount * sizeof(float));
+
+	glGenVertexArrays(1, &_instancedVao);
+	glBindVertexArray(_instancedVao);
+
+	// the triangle comes from the same VBO as in the per particle path
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+	for (GLuint attribute = 1; attribute <= 3; ++attribute) {
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribDivisor(attribute, 1);
+	}
+
+	bindInstanceAttributes(0);
+
+	_instancedShader = createProgram(getInstancedVertexShader(), getInstancedFragmentShader());
+	_instancedAlphaUniform = glGetUniformLocation(_instancedShader, "alpha");
+}
+
 bool Renderer::init() {
 
 	RendererPtr() = this;
@@ -141,22 +253,9 @@ bool Renderer::init() {
 	glBindBuffer(GL_ARRAY_BUFFER, _vbo);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-	const GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-
-	const auto* vsStr = getVerterShader();
-	const auto* fsStr = getFragmentShader();
-
-	glShaderSource(vs, 1, &vsStr, nullptr);
-	glCompileShader(vs);
-
-	const GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fs, 1, &fsStr, nullptr);
-	glCompileShader(fs);
+	_shader = createProgram(getVerterShader(), getFragmentShader());
 
-	_shader = glCreateProgram();
-	glAttachShader(_shader, fs);
-	glAttachShader(_shader, vs);
-	glLinkProgram(_shader);
+	initInstancing();
 
 	glfwSetWindowSizeCallback(_window, windowSizeCB);
 	glfwSetWindowCloseCallback(_window, windowCloseCB);
@@ -169,6 +268,8 @@ bool Renderer::init() {
 
 void Renderer::loop() {
 	
+	PROFILE_THREAD_NAME("render");
+
 	_prevRenderTime = getTime();
 	_timeVault = 0;
 
@@ -188,17 +289,31 @@ void Renderer::loop() {
 			continue;
 		}
 
+		_latency._wakeupDelay.Record(static_cast<uint64_t>((_timeVault - renderMinCooldown) * 1e9));
+
+		unsigned steps = 0;
 		while (_timeVault >= renderMinCooldown && !_stopRequest)
 		{
 			_timeVault -= renderMinCooldown;
 
-			const auto beforeRender = getTime();
+			// I may switch the mode during the frame, it is counted for the mode it was drawn in
+			const auto modeInd = static_cast<unsigned>(_renderMode);
+
+			const auto beforeRender = getTimeNs();
 			render();
-			const auto afterRender = getTime();
+			const auto afterRender = getTimeNs();
 
 			const auto renderDuration = afterRender - beforeRender;
+			_latency._stepTime.Record(renderDuration);
+
+			_modeFrameTime[modeInd].Record(renderDuration);
+			_modeDrawCalls[modeInd].Record(_drawCalls);
+			_lastFrameTime = renderDuration * 1e-9;
+			++steps;
 			//printf("RENDER %f\n", renderDuration);
 		}
+
+		_latency._catchUpSteps.Record(steps);
 	}
 
 	_particleSystem->Stop();
@@ -206,6 +321,22 @@ void Renderer::loop() {
 	glfwSetWindowShouldClose(_window, 1);
 }
 
+void Renderer::PrintLatency() const {
+
+	_latency.Print("render");
+
+	for (const auto renderMode : {RenderMode::PerParticle, RenderMode::Instanced}) {
+
+		const auto modeInd = static_cast<unsigned>(renderMode);
+		if (_modeFrameTime[modeInd].GetCount() == 0)
+			continue;
+
+		printf("%s rendering:\n", getRenderModeName(renderMode));
+		_modeFrameTime[modeInd].Print("frame time", "us", 1000.0);
+		_modeDrawCalls[modeInd].Print("draw calls", "calls", 1.0);
+	}
+}
+
 void Renderer::initUniforms() {
 
 	const auto initUniform = [this](const std::string& name, int& var) {
@@ -215,8 +346,8 @@ void Renderer::initUniforms() {
 
 	initUniform("alpha", _alphaUniform);
 	initUniform("color", _colorUniform);
-	initUniform("scale", _scaleUniform);
-	initUniform("offset", _offsetUniform);
+	initUniform("position", _positionUniform);
+	initUniform("lifetime", _lifetimeUniform);
 }
 
 void Renderer::renderParticle(const ParticleVisualInfo& particleInfo) {
@@ -229,59 +360,90 @@ void Renderer::renderParticle(const ParticleVisualInfo& particleInfo) {
 	
 	glUniform3f(_colorUniform, r, g, b);
 
-	float scale = particleScaleDefault;
-	constexpr float zeroScale = 0.001f;
-
-	if (!particleInfo.GetIsWithinLifetime()) {
-		scale = zeroScale;
-	}
-	else 
-	{
-		const auto maxTime = particleInfo._maxLifetime;
-		const auto currTime = particleInfo._currLifetime;
-		const auto remainingTime = maxTime - currTime;
-		if (remainingTime < particleFadeoutTime)
-		{
-			const float coeff = std::max(static_cast<float>(remainingTime / particleFadeoutTime), zeroScale);
-			scale *= coeff;
-		}
-	}
-	
+	// raw position and lifetime, the vertex shader works out the fade and the clip space offset
 	const auto& pos = particleInfo._position;
-	const float offsetX = 2.f * (pos._x - 0.5f);
-	const float offsetY = 2.f * (pos._y - 0.5f);
-
-	glUniform1f(_scaleUniform, scale);
-	glUniform2f(_offsetUniform, offsetX, offsetY);
+	glUniform2f(_positionUniform, pos._x, pos._y);
+	glUniform2f(_lifetimeUniform, static_cast<float>(particleInfo._currLifetime), static_cast<float>(particleInfo._maxLifetime));
 
 	glDrawArrays(GL_TRIANGLES, 0, 3);
 
+	++_drawCalls;
 	++_particlesRendered;
 }
 
 void Renderer::renderEffect(const Effect& effect) {
 
-	const auto& particles = effect.GetParticles();
-	for (const auto& particle : particles) {
+	if (!effect.BeginRead())
+		return;
 
-		if (!particle.IsAlive())
-			continue;
+	const auto& particles = effect.GetParticles();
+	for (unsigned index = 0; index < particles.GetCount(); ++index) {
 
+		const auto particle = particles[index];
 		const auto& info = particle.GetVisualInfo();
 		renderParticle(info);
 	}
 
 	effect.RequestSwapParticleBuffer();
+	effect.EndRead();
 
 	++_effectsRendered;
 }
 
+// instanced VAO must be bound, offset is where this frame's segment starts in the stream buffer
+void Renderer::bindInstanceAttributes(const size_t offset) {
+
+	constexpr GLsizei stride = instanceFloatsCount * sizeof(float);
+	glBindBuffer(GL_ARRAY_BUFFER, _instanceStream.GetBuffer());
+
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(offset));
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(offset + 2 * sizeof(float)));
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(offset + 4 * sizeof(float)));
+}
+
+void Renderer::renderInstanced() {
+
+	++_instancedFrames;
+
+	// the gather workers write particles straight into the stream buffer segment of this frame,
+	// this thread only uploads and draws
+	auto* instances = static_cast<float*>(_instanceStream.BeginWrite());
+	if (!instances)
+		return;
+
+	const unsigned instancesCount = _gather.Gather(_particleSystem->GetEffects(), instances, maxInstancesCount);
+	const size_t offset = _instanceStream.EndWrite(size_t(instancesCount) * instanceFloatsCount * sizeof(float));
+
+	_particlesRendered += instancesCount;
+	_effectsRendered += _gather.GetEffectsCount();
+
+	if (instancesCount > 0) {
+		glUseProgram(_instancedShader);
+		glUniform1f(_instancedAlphaUniform, particleAlpha);
+		glBindVertexArray(_instancedVao);
+		bindInstanceAttributes(offset);
+
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 3, static_cast<GLsizei>(instancesCount));
+		++_drawCalls;
+	}
+
+	_instanceStream.Fence();
+}
+
 void Renderer::render() {
 
+	PROFILE_ZONE("Renderer::render");
+
 	//printf("render\n");
 	
 	beginRender();
 
+	if (_renderMode == RenderMode::Instanced) {
+		renderInstanced();
+		endRender();
+		return;
+	}
+
 	const auto& effects = _particleSystem->GetEffects();
 	for (const Effect& effect : effects)
 	{
@@ -295,6 +457,8 @@ void Renderer::render() {
 
 void Renderer::endRender() {
 
+	PROFILE_ZONE("Renderer::endRender");
+
 	const auto t1 = getTime();
 
 	glfwSwapBuffers(_window);
@@ -306,6 +470,20 @@ void Renderer::endRender() {
 	glfwPollEvents();
 	if (GLFW_PRESS == glfwGetKey(_window, GLFW_KEY_ESCAPE))
 		_particleSystem->SoftStop();
+
+	// L prints the latency percentiles gathered so far
+	const bool latencyKeyDown = GLFW_PRESS == glfwGetKey(_window, GLFW_KEY_L);
+	if (latencyKeyDown && !_latencyKeyDown) {
+		_particleSystem->PrintLatency();
+		PrintLatency();
+	}
+	_latencyKeyDown = latencyKeyDown;
+
+	// I switches between the per particle and the instanced path
+	const bool renderModeKeyDown = GLFW_PRESS == glfwGetKey(_window, GLFW_KEY_I);
+	if (renderModeKeyDown && !_renderModeKeyDown)
+		_renderMode = _renderMode == RenderMode::Instanced ? RenderMode::PerParticle : RenderMode::Instanced;
+	_renderModeKeyDown = renderModeKeyDown;
 }
 
 void Renderer::beginRender()
@@ -314,6 +492,7 @@ void Renderer::beginRender()
 
 	_particlesRendered = 0;
 	_effectsRendered = 0;
+	_drawCalls = 0;
 	
 	glClear(GL_COLOR_BUFFER_BIT);
 	glViewport(0, 0, _width, _height);
@@ -1,20 +1,37 @@
 #pragma once
 
 #include <vector>
+#include "LatencyHistogram.h"
+#include "ParallelGather.h"
+#include "StreamBuffer.h"
+#include "WorkerPool.h"
 
 struct GLFWwindow;
 class Effect;
 struct ParticleVisualInfo;
 class ParticleSystem;
 
+// PerParticle sets uniforms and issues a draw call for every particle, Instanced packs all particles into an
+// instance buffer and draws them with one call. I switches between them while running
+enum class RenderMode
+{
+	PerParticle,
+	Instanced,
+};
+
 class Renderer
 {
 public:
 
-	Renderer(ParticleSystem* system);
+	Renderer(ParticleSystem* system, RenderMode renderMode = RenderMode::PerParticle);
 	bool SetSize(int x, int y);
 	void Stop();
 
+	// render loop latencies, step time covers a whole frame
+	const LoopLatency& GetLatency() const { return _latency; }
+	// also prints frame time and draw calls per frame of every render mode used
+	void PrintLatency() const;
+
 protected:
 	
 	bool init();
@@ -29,6 +46,12 @@ protected:
 	void renderEffect(const Effect&);
 	void renderParticle(const ParticleVisualInfo&);
 
+	void renderInstanced();
+	void bindInstanceAttributes(size_t offset);
+
+	// also sets the fade constants every vertex shader shares
+	unsigned createProgram(const char* vertexShader, const char* fragmentShader);
+	void initInstancing();
 	void initUniforms();
 
 private:
@@ -39,6 +62,18 @@ private:
 	unsigned int _vao = 0;
 	unsigned int _vbo = 0;
 
+	RenderMode _renderMode = RenderMode::PerParticle;
+	bool _renderModeKeyDown = false;
+
+	unsigned int _instancedShader = 0;
+	unsigned int _instancedVao = 0;
+	int _instancedAlphaUniform = -1;
+	// ParallelGather instances, a segment holds every particle the system can hold
+	StreamBuffer _instanceStream;
+	// sized to the hardware threads the effect scheduler leaves free
+	WorkerPool _gatherWorkers;
+	ParallelGather _gather;
+
 	GLFWwindow* _window = nullptr;
 
 	int _width = 0;
@@ -54,13 +89,23 @@ private:
 
 	bool _stopRequest = false;
 
+	LoopLatency _latency;
+	bool _latencyKeyDown = false;
+
 	unsigned _effectsRendered = 0;
 	unsigned _particlesRendered = 0;
+	unsigned _drawCalls = 0;
+	double _lastFrameTime = 0.0;
+	unsigned _instancedFrames = 0;
+
+	// per render mode: frame time in ns and draw calls per frame
+	LatencyHistogram _modeFrameTime[2];
+	LatencyHistogram _modeDrawCalls[2];
 
 	int _alphaUniform = -1;
 	int _colorUniform = -1;
-	int _scaleUniform = -1;
-	int _offsetUniform = -1;
+	int _positionUniform = -1;
+	int _lifetimeUniform = -1;
 	
 };
 
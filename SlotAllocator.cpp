@@ -0,0 +1,53 @@
+#include "SlotAllocator.h"
+#include <cassert>
+
+static uint64_t makeHead(const uint64_t prevHead, const uint32_t top) {
+	const uint64_t tag = (prevHead >> 32) + 1;
+	return (tag << 32) | top;
+}
+
+SlotAllocator::SlotAllocator(const unsigned capacity) : _next(capacity) {
+
+	for (unsigned index = 0; index < capacity; ++index)
+		_next[index].store(index + 2 <= capacity ? index + 2 : 0, std::memory_order_relaxed);
+
+	_head = capacity > 0 ? 1 : 0;
+	_freeCount = capacity;
+}
+
+bool SlotAllocator::Acquire(unsigned& index) {
+
+	uint64_t head = _head.load(std::memory_order_acquire);
+
+	while (true) {
+
+		const uint32_t top = static_cast<uint32_t>(head);
+		if (top == 0) {
+			_failedAcquireCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		const uint32_t next = _next[top - 1].load(std::memory_order_relaxed);
+		if (_head.compare_exchange_weak(head, makeHead(head, next), std::memory_order_acq_rel, std::memory_order_acquire)) {
+			index = top - 1;
+			break;
+		}
+	}
+
+	_freeCount.fetch_sub(1, std::memory_order_relaxed);
+	_acquiredCount.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void SlotAllocator::Release(const unsigned index) {
+
+	assert(index < _next.size());
+
+	uint64_t head = _head.load(std::memory_order_relaxed);
+	do {
+		_next[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+	} while (!_head.compare_exchange_weak(head, makeHead(head, index + 1), std::memory_order_release, std::memory_order_relaxed));
+
+	_freeCount.fetch_add(1, std::memory_order_relaxed);
+	_releasedCount.fetch_add(1, std::memory_order_relaxed);
+}
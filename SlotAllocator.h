@@ -0,0 +1,33 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Lock-free free list of slot indices (Treiber stack with an ABA tag), acquire and release are O(1)
+// and may be called from any thread. Initially every slot is free and lower indices are handed out first.
+class SlotAllocator
+{
+public:
+	explicit SlotAllocator(unsigned capacity);
+
+	bool Acquire(unsigned& index);
+	void Release(unsigned index);
+
+	unsigned GetCapacity() const { return static_cast<unsigned>(_next.size()); }
+	unsigned GetFreeCount() const { return _freeCount.load(std::memory_order_relaxed); }
+
+	uint64_t GetAcquiredCount() const { return _acquiredCount.load(std::memory_order_relaxed); }
+	uint64_t GetReleasedCount() const { return _releasedCount.load(std::memory_order_relaxed); }
+	uint64_t GetFailedAcquireCount() const { return _failedAcquireCount.load(std::memory_order_relaxed); }
+
+private:
+	// low 32 bits hold index + 1 of the top slot (0 = empty), high 32 bits are bumped on every change
+	alignas(64) std::atomic<uint64_t> _head = 0;
+
+	std::vector<std::atomic<uint32_t>> _next;
+
+	alignas(64) std::atomic<unsigned> _freeCount = 0;
+	std::atomic<uint64_t> _acquiredCount = 0;
+	std::atomic<uint64_t> _releasedCount = 0;
+	std::atomic<uint64_t> _failedAcquireCount = 0;
+};
@@ -0,0 +1,342 @@
+#include "SoftwareRenderer.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "Profiler.h"
+#include "Utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PP_RASTER_SSE2 1
+#include <emmintrin.h>
+#else
+#define PP_RASTER_SSE2 0
+#endif
+
+static constexpr unsigned instanceFloatsCount = ParallelGather::instanceFloatsCount;
+static constexpr unsigned maxInstancesCount = maxEffectsCount * maxParticlesPerEffectCount;
+static constexpr unsigned tilePixelsCount = SoftwareRenderer::tileSize * SoftwareRenderer::tileSize;
+
+static_assert(SoftwareRenderer::tileSize % 4 == 0, "tile rows are rasterized 4 pixels at a time");
+
+// the GL renderer's triangle and the constants its vertex shader gets
+static constexpr float particleVertices[3][2] = {{0.f, 1.f}, {1.f, -1.f}, {-1.f, -1.f}};
+static constexpr float zeroScale = 0.001f;
+
+static uint8_t toUnorm8(const float value) {
+	return static_cast<uint8_t>(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+SoftwareRenderer::SoftwareRenderer(const int width, const int height, const unsigned workersCount)
+	: _width(std::max(width, 1)), _height(std::max(height, 1)), _workers(workersCount, "software render"), _gather(_workers) {
+
+	_tilesX = (static_cast<unsigned>(_width) + tileSize - 1) / tileSize;
+	_tilesY = (static_cast<unsigned>(_height) + tileSize - 1) / tileSize;
+	_tilesCount = _tilesX * _tilesY;
+
+	const unsigned workers = _workers.GetWorkersCount();
+
+	_instances.resize(size_t(maxInstancesCount) * instanceFloatsCount);
+	_triangles.resize(maxInstancesCount);
+	_binCounts.resize(size_t(workers) * _tilesCount);
+	_binOffsets.resize(size_t(workers) * _tilesCount);
+	_tileBins.resize(_tilesCount + 1);
+	// worst case once, so no frame allocates: the largest triangle spans scale * size pixels on each axis
+	const float maxScale = std::max(particleScaleDefault, zeroScale);
+	const unsigned maxTilesX = std::min(static_cast<unsigned>(std::ceil(maxScale * _width / tileSize)) + 1, _tilesX);
+	const unsigned maxTilesY = std::min(static_cast<unsigned>(std::ceil(maxScale * _height / tileSize)) + 1, _tilesY);
+	_binEntries.resize(size_t(maxInstancesCount) * maxTilesX * maxTilesY);
+	_tileColors.resize(size_t(workers) * 4 * tilePixelsCount);
+	_pixels.resize(size_t(_width) * _height * 4);
+}
+
+void SoftwareRenderer::runPhase(const Phase phase) {
+
+	_nextTile = 0;
+	_workers.Run(this, phase);
+}
+
+void SoftwareRenderer::getWorkerRange(const unsigned workerInd, unsigned& begin, unsigned& end) const {
+
+	const uint64_t workers = _workers.GetWorkersCount();
+	begin = static_cast<unsigned>(_instancesCount * uint64_t(workerInd) / workers);
+	end = static_cast<unsigned>(_instancesCount * uint64_t(workerInd + 1) / workers);
+}
+
+void SoftwareRenderer::setupTriangles(const unsigned workerInd) {
+
+	unsigned* binCounts = _binCounts.data() + size_t(workerInd) * _tilesCount;
+	std::fill(binCounts, binCounts + _tilesCount, 0u);
+
+	unsigned begin = 0, end = 0;
+	getWorkerRange(workerInd, begin, end);
+
+	const float width = static_cast<float>(_width);
+	const float height = static_cast<float>(_height);
+	const float fadeoutTime = static_cast<float>(particleFadeoutTime);
+
+	for (unsigned ind = begin; ind < end; ++ind) {
+
+		const float* instance = _instances.data() + size_t(ind) * instanceFloatsCount;
+		Triangle& triangle = _triangles[ind];
+
+		// particleVertex in the GL shaders, then the viewport transform with y flipped so row 0 is the top
+		const float remaining = instance[3] - instance[2];
+		const float scale = remaining > 0.f ? particleScaleDefault * std::max(std::min(remaining / fadeoutTime, 1.f), zeroScale) : zeroScale;
+
+		for (unsigned v = 0; v < 3; ++v) {
+			const float clipX = particleVertices[v][0] * scale + 2.f * (instance[0] - 0.5f);
+			const float clipY = particleVertices[v][1] * scale + 2.f * (instance[1] - 0.5f);
+			triangle._x[v] = (clipX + 1.f) * 0.5f * width;
+			triangle._y[v] = (1.f - clipY) * 0.5f * height;
+		}
+
+		const float area = (triangle._x[1] - triangle._x[0]) * (triangle._y[2] - triangle._y[0]) -
+			(triangle._y[1] - triangle._y[0]) * (triangle._x[2] - triangle._x[0]);
+
+		if (area < 0.f) {
+			std::swap(triangle._x[1], triangle._x[2]);
+			std::swap(triangle._y[1], triangle._y[2]);
+		}
+
+		for (unsigned e = 0; e < 3; ++e) {
+			const unsigned next = (e + 1) % 3;
+			triangle._edgeA[e] = triangle._y[e] - triangle._y[next];
+			triangle._edgeB[e] = triangle._x[next] - triangle._x[e];
+			const bool topLeft = triangle._edgeA[e] > 0.f || (triangle._edgeA[e] == 0.f && triangle._edgeB[e] > 0.f);
+			triangle._topLeft[e] = topLeft ? ~0u : 0u;
+		}
+
+		triangle._r = instance[4];
+		triangle._g = instance[5];
+		triangle._b = instance[6];
+
+		// pixels whose centers can be covered
+		const float minX = std::min({triangle._x[0], triangle._x[1], triangle._x[2]});
+		const float maxX = std::max({triangle._x[0], triangle._x[1], triangle._x[2]});
+		const float minY = std::min({triangle._y[0], triangle._y[1], triangle._y[2]});
+		const float maxY = std::max({triangle._y[0], triangle._y[1], triangle._y[2]});
+
+		triangle._minX = std::max(static_cast<int>(std::ceil(minX - 0.5f)), 0);
+		triangle._maxX = std::min(static_cast<int>(std::floor(maxX - 0.5f)) + 1, _width);
+		triangle._minY = std::max(static_cast<int>(std::ceil(minY - 0.5f)), 0);
+		triangle._maxY = std::min(static_cast<int>(std::floor(maxY - 0.5f)) + 1, _height);
+
+		// degenerate triangles draw nothing in GL either
+		if (area == 0.f || triangle._minX >= triangle._maxX || triangle._minY >= triangle._maxY) {
+			triangle._maxX = triangle._minX;
+			continue;
+		}
+
+		for (int ty = triangle._minY / tileSize; ty <= (triangle._maxY - 1) / static_cast<int>(tileSize); ++ty)
+			for (int tx = triangle._minX / tileSize; tx <= (triangle._maxX - 1) / static_cast<int>(tileSize); ++tx)
+				++binCounts[ty * _tilesX + tx];
+	}
+}
+
+void SoftwareRenderer::fillBins(const unsigned workerInd) {
+
+	unsigned* binOffsets = _binOffsets.data() + size_t(workerInd) * _tilesCount;
+
+	unsigned begin = 0, end = 0;
+	getWorkerRange(workerInd, begin, end);
+
+	for (unsigned ind = begin; ind < end; ++ind) {
+
+		const Triangle& triangle = _triangles[ind];
+		if (triangle._minX >= triangle._maxX)
+			continue;
+
+		for (int ty = triangle._minY / tileSize; ty <= (triangle._maxY - 1) / static_cast<int>(tileSize); ++ty)
+			for (int tx = triangle._minX / tileSize; tx <= (triangle._maxX - 1) / static_cast<int>(tileSize); ++tx)
+				_binEntries[binOffsets[ty * _tilesX + tx]++] = ind;
+	}
+}
+
+void SoftwareRenderer::rasterizeTriangle(const Triangle& triangle, const int tileX, const int tileY, float* tile) const {
+
+	const int beginX = std::max(triangle._minX, tileX);
+	const int endX = std::min(triangle._maxX, tileX + static_cast<int>(tileSize));
+	const int beginY = std::max(triangle._minY, tileY);
+	const int endY = std::min(triangle._maxY, tileY + static_cast<int>(tileSize));
+
+	// rows are walked in aligned groups of 4, pixels left of beginX lie outside the triangle's bounds
+	const int groupBeginX = tileX + ((beginX - tileX) & ~3);
+
+	const float alpha = particleAlpha;
+	const float srcR = triangle._r * alpha;
+	const float srcG = triangle._g * alpha;
+	const float srcB = triangle._b * alpha;
+	const float srcA = alpha * alpha;
+	const float dstScale = 1.f - alpha;
+
+#if PP_RASTER_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 laneCenters = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 src[4] = {_mm_set1_ps(srcR), _mm_set1_ps(srcG), _mm_set1_ps(srcB), _mm_set1_ps(srcA)};
+	const __m128 dstScale4 = _mm_set1_ps(dstScale);
+
+	__m128 edgeA[3], edgeX[3], topLeft[3];
+	for (unsigned e = 0; e < 3; ++e) {
+		edgeA[e] = _mm_set1_ps(triangle._edgeA[e]);
+		edgeX[e] = _mm_set1_ps(triangle._x[e]);
+		topLeft[e] = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(triangle._topLeft[e])));
+	}
+
+	for (int y = beginY; y < endY; ++y) {
+
+		const float centerY = static_cast<float>(y) + 0.5f;
+		__m128 rowEdge[3];
+		for (unsigned e = 0; e < 3; ++e)
+			rowEdge[e] = _mm_set1_ps(triangle._edgeB[e] * (centerY - triangle._y[e]));
+
+		float* row = tile + (y - tileY) * tileSize;
+
+		for (int x = groupBeginX; x < endX; x += 4) {
+
+			const __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneCenters);
+
+			__m128 covered = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (unsigned e = 0; e < 3; ++e) {
+				const __m128 edge = _mm_add_ps(_mm_mul_ps(edgeA[e], _mm_sub_ps(centerX, edgeX[e])), rowEdge[e]);
+				const __m128 inside = _mm_or_ps(_mm_cmpgt_ps(edge, zero), _mm_and_ps(_mm_cmpeq_ps(edge, zero), topLeft[e]));
+				covered = _mm_and_ps(covered, inside);
+			}
+
+			if (_mm_movemask_ps(covered) == 0)
+				continue;
+
+			float* pixels = row + (x - tileX);
+			for (unsigned channel = 0; channel < 4; ++channel, pixels += tilePixelsCount) {
+				const __m128 dst = _mm_loadu_ps(pixels);
+				const __m128 blended = _mm_add_ps(src[channel], _mm_mul_ps(dst, dstScale4));
+				_mm_storeu_ps(pixels, _mm_or_ps(_mm_and_ps(covered, blended), _mm_andnot_ps(covered, dst)));
+			}
+		}
+	}
+#else
+	const float src[4] = {srcR, srcG, srcB, srcA};
+
+	for (int y = beginY; y < endY; ++y) {
+
+		const float centerY = static_cast<float>(y) + 0.5f;
+		float* row = tile + (y - tileY) * tileSize;
+
+		for (int x = groupBeginX; x < endX; ++x) {
+
+			const float centerX = static_cast<float>(x) + 0.5f;
+
+			bool covered = true;
+			for (unsigned e = 0; e < 3; ++e) {
+				const float edge = triangle._edgeA[e] * (centerX - triangle._x[e]) + triangle._edgeB[e] * (centerY - triangle._y[e]);
+				covered = covered && (edge > 0.f || (edge == 0.f && triangle._topLeft[e] != 0));
+			}
+
+			if (!covered)
+				continue;
+
+			float* pixel = row + (x - tileX);
+			for (unsigned channel = 0; channel < 4; ++channel, pixel += tilePixelsCount)
+				*pixel = src[channel] + *pixel * dstScale;
+		}
+	}
+#endif
+}
+
+void SoftwareRenderer::resolveTile(const unsigned tileInd, const float* tile) {
+
+	const int tileX = static_cast<int>(tileInd % _tilesX * tileSize);
+	const int tileY = static_cast<int>(tileInd / _tilesX * tileSize);
+	const int width = std::min(static_cast<int>(tileSize), _width - tileX);
+	const int height = std::min(static_cast<int>(tileSize), _height - tileY);
+
+	for (int y = 0; y < height; ++y) {
+
+		uint8_t* pixel = _pixels.data() + (size_t(tileY + y) * _width + tileX) * 4;
+
+		if (!tile) {
+			std::memset(pixel, 0, size_t(width) * 4);
+			continue;
+		}
+
+		const float* row = tile + y * tileSize;
+		for (int x = 0; x < width; ++x, pixel += 4) {
+			pixel[0] = toUnorm8(row[x]);
+			pixel[1] = toUnorm8(row[x + tilePixelsCount]);
+			pixel[2] = toUnorm8(row[x + 2 * tilePixelsCount]);
+			pixel[3] = toUnorm8(row[x + 3 * tilePixelsCount]);
+		}
+	}
+}
+
+void SoftwareRenderer::rasterizeTiles(const unsigned workerInd) {
+
+	float* tile = _tileColors.data() + size_t(workerInd) * 4 * tilePixelsCount;
+
+	for (unsigned tileInd = _nextTile++; tileInd < _tilesCount; tileInd = _nextTile++) {
+
+		const unsigned binsBegin = _tileBins[tileInd];
+		const unsigned binsEnd = _tileBins[tileInd + 1];
+
+		// the clear color is all zeros
+		if (binsBegin == binsEnd) {
+			resolveTile(tileInd, nullptr);
+			continue;
+		}
+
+		std::fill(tile, tile + 4 * tilePixelsCount, 0.f);
+
+		const int tileX = static_cast<int>(tileInd % _tilesX * tileSize);
+		const int tileY = static_cast<int>(tileInd / _tilesX * tileSize);
+
+		for (unsigned entry = binsBegin; entry < binsEnd; ++entry)
+			rasterizeTriangle(_triangles[_binEntries[entry]], tileX, tileY, tile);
+
+		resolveTile(tileInd, tile);
+	}
+}
+
+void SoftwareRenderer::Render(const std::vector<Effect>& effects) {
+
+	PROFILE_ZONE("SoftwareRenderer::Render");
+
+	const uint64_t startTime = getTimeNs();
+
+	_instancesCount = _gather.Gather(effects, _instances.data(), maxInstancesCount);
+
+	runPhase(&SoftwareRenderer::setupTriangles);
+
+	// tile major prefix sum, so every tile lists its triangles in the order they were gathered
+	const unsigned workers = _workers.GetWorkersCount();
+	unsigned total = 0;
+
+	for (unsigned tileInd = 0; tileInd < _tilesCount; ++tileInd) {
+
+		_tileBins[tileInd] = total;
+
+		for (unsigned workerInd = 0; workerInd < workers; ++workerInd) {
+			const size_t binInd = size_t(workerInd) * _tilesCount + tileInd;
+			_binOffsets[binInd] = total;
+			total += _binCounts[binInd];
+		}
+	}
+	_tileBins[_tilesCount] = total;
+	assert(total <= _binEntries.size());
+
+	runPhase(&SoftwareRenderer::fillBins);
+	runPhase(&SoftwareRenderer::rasterizeTiles);
+
+	_particlesRendered = _instancesCount;
+	++_framesCount;
+	_frameTime.Record(getTimeNs() - startTime);
+}
+
+void SoftwareRenderer::Print() const {
+
+	printf("software renderer %dx%d, %u tiles of %u px, %u workers, %s edge functions, frames %llu, particles in last frame %u\n",
+		_width, _height, _tilesCount, tileSize, _workers.GetWorkersCount(), PP_RASTER_SSE2 ? "sse2" : "scalar",
+		static_cast<unsigned long long>(_framesCount), _particlesRendered);
+	_frameTime.Print("frame time", "ms", 1000000.0);
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Config.h"
+#include "LatencyHistogram.h"
+#include "ParallelGather.h"
+#include "WorkerPool.h"
+
+class Effect;
+
+// CPU backend drawing what the GL Renderer draws, for machines without a GPU. Particles are gathered like the
+// instanced path, turned into the same triangles as the vertex shader, binned into square screen tiles in submission
+// order and the tiles are rasterized in parallel with SIMD edge functions. Every fragment is blended as
+// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) would, in the same order as the GL draws them.
+// The frame is kept in memory as RGBA8, top row first, any size from one pixel up.
+class SoftwareRenderer
+{
+public:
+	// pixels per tile side, one tile of float color stays within L1
+	static constexpr unsigned tileSize = 32;
+
+	// workersCount 0 means one worker per hardware thread
+	SoftwareRenderer(int width = sceneWidth, int height = sceneHeight, unsigned workersCount = 0);
+
+	SoftwareRenderer(const SoftwareRenderer&) = delete;
+	SoftwareRenderer& operator=(const SoftwareRenderer&) = delete;
+
+	// draws the latest snapshot of every live effect, this is the renderer's snapshot read so only one thread may
+	// render and no other renderer may run at the same time
+	void Render(const std::vector<Effect>& effects);
+
+	int GetWidth() const { return _width; }
+	int GetHeight() const { return _height; }
+	// width * height RGBA8 pixels, top row first
+	const uint8_t* GetPixels() const { return _pixels.data(); }
+
+	uint64_t GetFramesCount() const { return _framesCount; }
+	unsigned GetParticlesRendered() const { return _particlesRendered; }
+	// wall time of a whole Render call, ns
+	const LatencyHistogram& GetFrameTime() const { return _frameTime; }
+
+	void Print() const;
+
+private:
+	// one particle's triangle in pixel coordinates, inside edge e when _edgeA[e] * (x - _x[e]) + _edgeB[e] * (y - _y[e]) > 0
+	struct Triangle
+	{
+		float _x[3];
+		float _y[3];
+		float _edgeA[3];
+		float _edgeB[3];
+		// edges a pixel center lying exactly on still belongs to, all bits set or clear
+		uint32_t _topLeft[3];
+		float _r, _g, _b;
+		// clipped pixel bounds, end exclusive, empty when the triangle covers no pixel
+		int _minX, _minY, _maxX, _maxY;
+	};
+
+	using Phase = void (SoftwareRenderer::*)(unsigned workerInd);
+
+	void runPhase(Phase phase);
+
+	void setupTriangles(unsigned workerInd);
+	void fillBins(unsigned workerInd);
+	void rasterizeTiles(unsigned workerInd);
+
+	void rasterizeTriangle(const Triangle& triangle, int tileX, int tileY, float* tile) const;
+	void resolveTile(unsigned tileInd, const float* tile);
+
+	// instances [begin, end) set up and binned by one worker, fixed shares keep the submission order per tile
+	void getWorkerRange(unsigned workerInd, unsigned& begin, unsigned& end) const;
+
+	int _width = 0;
+	int _height = 0;
+	unsigned _tilesX = 0;
+	unsigned _tilesY = 0;
+	unsigned _tilesCount = 0;
+
+	WorkerPool _workers;
+	ParallelGather _gather;
+
+	std::vector<float> _instances;
+	std::vector<Triangle> _triangles;
+	unsigned _instancesCount = 0;
+
+	// per worker and tile: triangles binned, then where the worker writes them; tile major, so the bins of
+	// one tile list worker 0's triangles first, which are the earliest ones
+	std::vector<unsigned> _binCounts;
+	std::vector<unsigned> _binOffsets;
+	// first bin entry of every tile plus the end
+	std::vector<unsigned> _tileBins;
+	std::vector<unsigned> _binEntries;
+
+	// color and alpha planes of one tile per worker
+	std::vector<float> _tileColors;
+	std::atomic<unsigned> _nextTile = 0;
+
+	std::vector<uint8_t> _pixels;
+
+	uint64_t _framesCount = 0;
+	unsigned _particlesRendered = 0;
+	LatencyHistogram _frameTime;
+};
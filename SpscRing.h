@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+// Fixed-capacity lock-free ring for exactly one producer and one consumer thread.
+// Capacity is rounded up to a power of two and must be set before both sides start using the ring.
+template<typename T>
+class SpscRing
+{
+	static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value, "items may live in raw external storage");
+
+public:
+	static size_t GetRoundedCapacity(size_t capacity) {
+
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+
+		return size;
+	}
+
+	// bytes Attach expects for the given capacity
+	static size_t GetStorageSize(size_t capacity) { return GetRoundedCapacity(capacity) * sizeof(T); }
+
+	// allocates own storage
+	void Resize(size_t capacity) {
+
+		const size_t size = GetRoundedCapacity(capacity);
+		_ownedItems = std::make_unique<T[]>(size);
+		attach(_ownedItems.get(), size);
+	}
+
+	// puts the ring on external storage of GetStorageSize(capacity) bytes, which it neither clears nor frees,
+	// capacity 0 detaches it. Only while empty
+	void Attach(void* storage, size_t capacity) {
+
+		_ownedItems.reset();
+		attach(static_cast<T*>(storage), capacity > 0 ? GetRoundedCapacity(capacity) : 0);
+	}
+
+	size_t GetCapacity() const { return _capacity; }
+
+	bool Push(const T& item) {
+
+		const size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) == _capacity)
+			return false;
+
+		_items[tail & _mask] = item;
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// hands every available item to f without copying it out of the ring
+	template<typename F>
+	size_t Consume(F&& f) {
+
+		const size_t head = _head.load(std::memory_order_relaxed);
+		const size_t tail = _tail.load(std::memory_order_acquire);
+
+		for (size_t i = head; i != tail; ++i)
+			f(_items[i & _mask]);
+
+		_head.store(tail, std::memory_order_release);
+		return tail - head;
+	}
+
+	bool Empty() const {
+		return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+	}
+
+private:
+	void attach(T* items, size_t capacity) {
+
+		assert(Empty());
+
+		_items = items;
+		_capacity = capacity;
+		_mask = capacity > 0 ? capacity - 1 : 0;
+	}
+
+	std::unique_ptr<T[]> _ownedItems;
+	T* _items = nullptr;
+	size_t _capacity = 0;
+	size_t _mask = 0;
+
+	alignas(64) std::atomic<size_t> _head = 0;
+	alignas(64) std::atomic<size_t> _tail = 0;
+};
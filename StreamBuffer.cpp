@@ -0,0 +1,105 @@
+#include "StreamBuffer.h"
+#include <cassert>
+
+#include <GL/glew.h>
+
+#include "Utils.h"
+
+StreamBuffer::~StreamBuffer() {
+
+	if (!_buffer)
+		return;
+
+	for (void* fence : _fences)
+		if (fence)
+			glDeleteSync(static_cast<GLsync>(fence));
+
+	glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+	if (_persistent)
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+
+	glDeleteBuffers(1, &_buffer);
+}
+
+void StreamBuffer::Init(const size_t segmentSize) {
+
+	assert(!_buffer);
+
+	_segmentSize = segmentSize;
+	_persistent = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+
+	glGenBuffers(1, &_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+
+	if (_persistent) {
+		constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, segmentsCount * segmentSize, nullptr, flags);
+		_mapped = static_cast<uint8_t*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, segmentsCount * segmentSize, flags));
+
+		// some drivers advertise the extension and still fail the mapping
+		if (!_mapped) {
+			_persistent = false;
+			glDeleteBuffers(1, &_buffer);
+			glGenBuffers(1, &_buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+		}
+	}
+
+	if (!_persistent)
+		glBufferData(GL_ARRAY_BUFFER, segmentSize, nullptr, GL_STREAM_DRAW);
+}
+
+void* StreamBuffer::BeginWrite() {
+
+	if (!_persistent) {
+		glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+		// orphaning: the driver hands out fresh storage while draws of earlier frames keep the old one
+		glBufferData(GL_ARRAY_BUFFER, _segmentSize, nullptr, GL_STREAM_DRAW);
+		return glMapBufferRange(GL_ARRAY_BUFFER, 0, _segmentSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	}
+
+	_segment = (_segment + 1) % segmentsCount;
+
+	if (auto fence = static_cast<GLsync>(_fences[_segment])) {
+
+		const uint64_t waitStart = getTimeNs();
+
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+		_fenceWaitNs += getTimeNs() - waitStart;
+
+		glDeleteSync(fence);
+		_fences[_segment] = nullptr;
+	}
+
+	return _mapped + _segment * _segmentSize;
+}
+
+size_t StreamBuffer::EndWrite(const size_t bytes) {
+
+	assert(bytes <= _segmentSize);
+	_uploadBytes += bytes;
+
+	if (!_persistent) {
+		glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		return 0;
+	}
+
+	// coherent mapping, the writes are visible to commands issued from now on
+	return _segment * _segmentSize;
+}
+
+void StreamBuffer::Fence() {
+
+	if (_persistent)
+		_fences[_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::ResetStats() {
+
+	_uploadBytes = 0;
+	_fenceWaitNs = 0;
+}
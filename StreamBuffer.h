@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Ring of segmentsCount equal segments in one GL array buffer for data streamed every frame. With ARB_buffer_storage
+// the buffer is persistently and coherently mapped and each segment is guarded by a fence, so the CPU writes one
+// segment while the GPU may still read the others. Without it every frame orphans the buffer and maps it afresh.
+// Needs a current GL context, all calls from the render thread.
+class StreamBuffer
+{
+public:
+	static constexpr unsigned segmentsCount = 3;
+
+	StreamBuffer() = default;
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// segmentSize is the most one frame may write
+	void Init(size_t segmentSize);
+
+	// waits until the GPU is done with the next segment and returns where to write this frame's data
+	void* BeginWrite();
+	// bytes actually written, returns the buffer offset they start at
+	size_t EndWrite(size_t bytes);
+	// after the draws reading this frame's data were issued
+	void Fence();
+
+	unsigned GetBuffer() const { return _buffer; }
+	bool IsPersistent() const { return _persistent; }
+
+	// totals since the last Reset, for averaging over frames
+	uint64_t GetUploadBytes() const { return _uploadBytes; }
+	uint64_t GetFenceWaitNs() const { return _fenceWaitNs; }
+	void ResetStats();
+
+private:
+	unsigned _buffer = 0;
+	size_t _segmentSize = 0;
+	bool _persistent = false;
+
+	uint8_t* _mapped = nullptr;
+	unsigned _segment = 0;
+	void* _fences[segmentsCount] = {};
+
+	uint64_t _uploadBytes = 0;
+	uint64_t _fenceWaitNs = 0;
+};
@@ -0,0 +1,159 @@
+#include "TimerWheel.h"
+#include <algorithm>
+
+size_t TimerWheel::GetStorageSize(const unsigned handlesCount) {
+	return handlesCount * (sizeof(uint64_t) + 3 * sizeof(uint32_t));
+}
+
+void TimerWheel::Resize(const unsigned handlesCount) {
+
+	auto storage = std::make_unique<uint64_t[]>((GetStorageSize(handlesCount) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+	Attach(storage.get(), handlesCount);
+	_ownedStorage = std::move(storage);
+
+	Clear(_nextTick);
+}
+
+void TimerWheel::Attach(void* storage, const unsigned handlesCount) {
+
+	_ownedStorage.reset();
+	_handlesCount = handlesCount;
+
+	std::fill(_heads.begin(), _heads.end(), none);
+	_count = 0;
+
+	if (handlesCount == 0) {
+		_expiry = nullptr;
+		_next = _prev = _bucket = nullptr;
+		return;
+	}
+
+	// expiries first, so every array stays naturally aligned
+	_expiry = static_cast<uint64_t*>(storage);
+	_next = reinterpret_cast<uint32_t*>(_expiry + handlesCount);
+	_prev = _next + handlesCount;
+	_bucket = _prev + handlesCount;
+}
+
+void TimerWheel::Clear(const uint64_t nextTick) {
+
+	std::fill(_heads.begin(), _heads.end(), none);
+	std::fill(_bucket, _bucket + _handlesCount, none);
+
+	_nextTick = nextTick;
+	_count = 0;
+}
+
+void TimerWheel::link(const unsigned handle, const unsigned bucket) {
+
+	const uint32_t head = _heads[bucket];
+
+	_next[handle] = head;
+	_prev[handle] = none;
+	_bucket[handle] = bucket;
+
+	if (head != none)
+		_prev[head] = handle;
+
+	_heads[bucket] = handle;
+}
+
+void TimerWheel::unlink(const unsigned handle) {
+
+	const uint32_t next = _next[handle];
+	const uint32_t prev = _prev[handle];
+
+	if (prev != none)
+		_next[prev] = next;
+	else
+		_heads[_bucket[handle]] = next;
+
+	if (next != none)
+		_prev[next] = prev;
+
+	_bucket[handle] = none;
+}
+
+void TimerWheel::Schedule(const unsigned handle, uint64_t expiryTick) {
+
+	assert(!IsScheduled(handle));
+
+	expiryTick = std::max(expiryTick, _nextTick);
+	_expiry[handle] = expiryTick;
+
+	// the level is picked by distance, the slot by the expiry bits of that level, as in the classic kernel timer wheel
+	const uint64_t delta = expiryTick - _nextTick;
+
+	unsigned level = 0;
+	while (level + 1 < levelsCount && delta >= (uint64_t(1) << ((level + 1) * levelBits)))
+		++level;
+
+	// beyond the top level the timer parks in its last slot and is cascaded again until it comes close
+	const uint64_t topRange = uint64_t(1) << (levelsCount * levelBits);
+	const uint64_t slotTick = delta < topRange ? expiryTick : _nextTick + topRange - 1;
+
+	const unsigned slot = static_cast<unsigned>((slotTick >> (level * levelBits)) & (slotsPerLevel - 1));
+	link(handle, level * slotsPerLevel + slot);
+
+	++_count;
+}
+
+void TimerWheel::Cancel(const unsigned handle) {
+
+	if (!IsScheduled(handle))
+		return;
+
+	unlink(handle);
+	--_count;
+}
+
+void TimerWheel::Move(const unsigned from, const unsigned to) {
+
+	assert(!IsScheduled(to));
+
+	if (!IsScheduled(from))
+		return;
+
+	const uint32_t next = _next[from];
+	const uint32_t prev = _prev[from];
+	const uint32_t bucket = _bucket[from];
+
+	_next[to] = next;
+	_prev[to] = prev;
+	_bucket[to] = bucket;
+	_expiry[to] = _expiry[from];
+
+	if (prev != none)
+		_next[prev] = to;
+	else
+		_heads[bucket] = to;
+
+	if (next != none)
+		_prev[next] = to;
+
+	_bucket[from] = none;
+}
+
+void TimerWheel::cascade() {
+
+	// a level is only due when every level below it has wrapped around
+	for (unsigned level = 1; level < levelsCount; ++level) {
+
+		const unsigned slot = static_cast<unsigned>((_nextTick >> (level * levelBits)) & (slotsPerLevel - 1));
+		const unsigned bucket = level * slotsPerLevel + slot;
+
+		uint32_t handle = _heads[bucket];
+		_heads[bucket] = none;
+
+		while (handle != none) {
+			const uint32_t next = _next[handle];
+			_bucket[handle] = none;
+			--_count;
+			Schedule(handle, _expiry[handle]);
+			handle = next;
+		}
+
+		if (slot != 0)
+			break;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Hierarchical timer wheel over tick numbers. Timers are small integer handles (particle slots) linked through
+// per-handle arrays, so nothing is allocated after Resize or Attach. Level 0 has one bucket per tick, every further level
+// covers slotsPerLevel times the range of the one below and is cascaded down as time reaches its buckets.
+// Not thread safe.
+class TimerWheel
+{
+public:
+	static constexpr unsigned levelBits = 6;
+	static constexpr unsigned slotsPerLevel = 1u << levelBits;
+	static constexpr unsigned levelsCount = 4;
+	static constexpr uint32_t none = UINT32_MAX;
+
+	// bytes Attach expects for the given handles count
+	static size_t GetStorageSize(unsigned handlesCount);
+
+	// allocates own per-handle arrays
+	void Resize(unsigned handlesCount);
+	// lays the per-handle arrays over external storage of GetStorageSize(handlesCount) bytes, aligned for uint64_t,
+	// which is not freed by the wheel. Nothing is written to the storage, Clear must be called before the first
+	// Schedule. handlesCount 0 detaches it
+	void Attach(void* storage, unsigned handlesCount);
+	unsigned GetHandlesCount() const { return _handlesCount; }
+
+	// drops every timer, nextTick is the first tick Advance will fire
+	void Clear(uint64_t nextTick);
+
+	// timers due before the next tick fire on the next tick
+	void Schedule(unsigned handle, uint64_t expiryTick);
+	void Cancel(unsigned handle);
+
+	// hands the timer of from over to the unscheduled handle to, for pools that move items around
+	void Move(unsigned from, unsigned to);
+
+	bool IsScheduled(unsigned handle) const { return _bucket[handle] != none; }
+	uint64_t GetExpiry(unsigned handle) const { return _expiry[handle]; }
+	uint64_t GetNextTick() const { return _nextTick; }
+	unsigned GetCount() const { return _count; }
+
+	// fires every timer due on the next tick as f(handle) and moves past it, f must not change the wheel
+	template<typename F>
+	unsigned Advance(F&& f) {
+
+		const unsigned slot = static_cast<unsigned>(_nextTick & (slotsPerLevel - 1));
+		if (slot == 0)
+			cascade();
+
+		uint32_t handle = _heads[slot];
+		_heads[slot] = none;
+
+		unsigned fired = 0;
+		while (handle != none) {
+
+			const uint32_t next = _next[handle];
+			assert(_expiry[handle] == _nextTick);
+
+			_bucket[handle] = none;
+			--_count;
+			++fired;
+
+			f(static_cast<unsigned>(handle));
+			handle = next;
+		}
+
+		++_nextTick;
+		return fired;
+	}
+
+private:
+	void link(unsigned handle, unsigned bucket);
+	void unlink(unsigned handle);
+	void cascade();
+
+	std::vector<uint32_t> _heads = std::vector<uint32_t>(levelsCount * slotsPerLevel, none);
+
+	std::unique_ptr<uint64_t[]> _ownedStorage;
+	unsigned _handlesCount = 0;
+
+	uint64_t* _expiry = nullptr;
+	uint32_t* _next = nullptr;
+	uint32_t* _prev = nullptr;
+	uint32_t* _bucket = nullptr;
+
+	uint64_t _nextTick = 0;
+	unsigned _count = 0;
+};
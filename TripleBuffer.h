@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single writer / single reader triple buffer. The writer fills its back buffer and publishes it,
+// the reader picks up the latest published buffer; neither side ever waits or sees a half-written buffer.
+template<typename T>
+class TripleBuffer
+{
+public:
+	template<typename F>
+	void ForEachBuffer(F&& f) {
+		for (auto& buffer : _buffers)
+			f(buffer);
+	}
+
+	T& GetWriteBuffer() { return _buffers[_writeInd]; }
+
+	void Publish() {
+		const uint8_t prevMiddle = _middle.exchange(static_cast<uint8_t>(_writeInd | freshBit), std::memory_order_acq_rel);
+		_writeInd = prevMiddle & indexMask;
+	}
+
+	// returns true if a newer buffer was published since the previous call
+	bool Update() {
+
+		if ((_middle.load(std::memory_order_relaxed) & freshBit) == 0)
+			return false;
+
+		const uint8_t prevMiddle = _middle.exchange(_readInd, std::memory_order_acq_rel);
+		_readInd = prevMiddle & indexMask;
+		return true;
+	}
+
+	const T& GetReadBuffer() const { return _buffers[_readInd]; }
+
+private:
+	static constexpr uint8_t indexMask = 0x3;
+	static constexpr uint8_t freshBit = 0x4;
+
+	T _buffers[3];
+
+	alignas(64) uint8_t _writeInd = 0;
+	alignas(64) std::atomic<uint8_t> _middle = 1;
+	alignas(64) uint8_t _readInd = 2;
+};
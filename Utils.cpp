@@ -1,16 +1,15 @@
 #include "Utils.h"
 
 #include <chrono>
-#include <random>
+#include "Random.h"
 //#include <GLFW/glfw3.h>
 
-static const float RANDOM_STRENGTH = 5000.f;
+static const unsigned RANDOM_STRENGTH = 5000;
 
+// [0, RANDOM_STRENGTH) as it always was
 size_t rnd()
 {
-	static std::default_random_engine rng(std::random_device{}());
-	static std::uniform_real_distribution<float> dist(0, RANDOM_STRENGTH);
-	return static_cast<size_t>(dist(rng));
+	return ThreadRandom().NextMinMax(0, RANDOM_STRENGTH - 1);
 }
 
 double getTime() {
@@ -25,8 +24,14 @@ double getTime() {
 	//return glfwGetTime();
 }
 
+uint64_t getTimeNs() {
+
+	const auto duration = std::chrono::steady_clock::now().time_since_epoch();
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
 float rnd01() {
-	return static_cast<float>(rnd()) / RANDOM_STRENGTH;
+	return ThreadRandom().Next01();
 }
 
 float rnd0xf(const float x) {
@@ -34,9 +39,7 @@ float rnd0xf(const float x) {
 }
 
 unsigned int rnd0xi(const unsigned int x) {
-	const auto randomNum = rnd();
-	const auto result = randomNum % (x + 1);
-	return static_cast<unsigned>(result);
+	return ThreadRandom().NextMinMax(0, x);
 }
 
 unsigned int rndMinMax(const unsigned int min, const unsigned int max)
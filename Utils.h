@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 
 size_t rnd();
 float rnd01();
@@ -9,3 +11,6 @@ unsigned int rndMinMax(const unsigned int min, const unsigned int max);
 bool rndYesNo();
 
 double getTime();
+
+// monotonic, for measuring durations
+uint64_t getTimeNs();
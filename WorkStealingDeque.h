@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Fixed-capacity Chase-Lev deque: the owner thread pushes and pops at the bottom, any other thread steals from the top.
+template<typename T>
+class WorkStealingDeque
+{
+public:
+	explicit WorkStealingDeque(unsigned capacity) {
+
+		unsigned size = 1;
+		while (size < capacity)
+			size <<= 1;
+
+		_buffer = std::vector<std::atomic<T>>(size);
+		_mask = size - 1;
+	}
+
+	bool Push(const T item) {
+
+		const int64_t b = _bottom.load(std::memory_order_relaxed);
+		const int64_t t = _top.load(std::memory_order_acquire);
+
+		if (b - t > static_cast<int64_t>(_mask))
+			return false;
+
+		_buffer[b & _mask].store(item, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		_bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool Pop(T& item) {
+
+		const int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+		_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = _top.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			_bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		item = _buffer[b & _mask].load(std::memory_order_relaxed);
+
+		if (t == b) {
+			// last item, race against thieves for it
+			const bool won = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			_bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+
+		return true;
+	}
+
+	bool Steal(T& item) {
+
+		int64_t t = _top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t b = _bottom.load(std::memory_order_acquire);
+
+		if (t >= b)
+			return false;
+
+		item = _buffer[t & _mask].load(std::memory_order_relaxed);
+		return _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	bool Empty() const {
+		return _bottom.load(std::memory_order_relaxed) <= _top.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::vector<std::atomic<T>> _buffer;
+	uint64_t _mask = 0;
+
+	alignas(64) std::atomic<int64_t> _top = 0;
+	alignas(64) std::atomic<int64_t> _bottom = 0;
+};
@@ -0,0 +1,87 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+#include "Profiler.h"
+
+WorkerPool::WorkerPool(const unsigned workersCount, const char* threadName) : _workersCount(workersCount), _threadName(threadName) {
+
+	if (_workersCount == 0)
+		_workersCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned i = 1; i < _workersCount; ++i)
+		_workers.emplace_back([this, i]() { workerLoop(i, 0); });
+}
+
+unsigned WorkerPool::GetSpareWorkersCount(const unsigned busyThreadsCount) {
+
+	const unsigned hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	return hardwareThreads > busyThreadsCount ? hardwareThreads - busyThreadsCount : 1;
+}
+
+WorkerPool::~WorkerPool() {
+
+	{
+		std::lock_guard<std::mutex> lock(_taskMutex);
+		_stopRequested = true;
+	}
+	_taskStartedCV.notify_all();
+
+	for (auto& worker : _workers)
+		worker.join();
+}
+
+void WorkerPool::workerLoop(const unsigned workerInd, unsigned seenGeneration) {
+
+	PROFILE_THREAD_NAME(_threadName, static_cast<int>(workerInd));
+
+	while (true) {
+
+		Task task = nullptr;
+		void* context = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(_taskMutex);
+			_taskStartedCV.wait(lock, [this, seenGeneration]() {
+				return _stopRequested || _taskGeneration != seenGeneration;
+			});
+
+			if (_stopRequested)
+				return;
+
+			seenGeneration = _taskGeneration;
+			task = _task;
+			context = _context;
+		}
+
+		task(context, workerInd);
+
+		{
+			std::lock_guard<std::mutex> lock(_taskMutex);
+			--_workersInTask;
+		}
+		_taskDoneCV.notify_one();
+	}
+}
+
+void WorkerPool::Run(const Task task, void* context) {
+
+	if (_workers.empty()) {
+		task(context, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_taskMutex);
+		_task = task;
+		_context = context;
+		_workersInTask = static_cast<unsigned>(_workers.size());
+		++_taskGeneration;
+	}
+	_taskStartedCV.notify_all();
+
+	task(context, 0);
+
+	std::unique_lock<std::mutex> lock(_taskMutex);
+	_taskDoneCV.wait(lock, [this]() {
+		return _workersInTask == 0;
+	});
+}
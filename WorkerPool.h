@@ -0,0 +1,61 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A few threads that run one task at a time on every worker and sleep in between, the calling thread works as
+// worker 0. Tasks hand out their own work, usually through an atomic index, the pool only starts them and waits.
+// Run must only be called from one thread at a time.
+class WorkerPool
+{
+public:
+	using Task = void (*)(void* context, unsigned workerInd);
+
+	// workersCount 0 means one worker per hardware thread, threadName is what the profiler shows
+	WorkerPool(unsigned workersCount, const char* threadName);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// runs task on every worker and returns when all are done
+	void Run(Task task, void* context);
+
+	// same for a member function of object, nothing is allocated
+	template<class T>
+	void Run(T* object, void (T::*method)(unsigned workerInd)) {
+
+		struct Call
+		{
+			T* _object;
+			void (T::*_method)(unsigned);
+		} call{object, method};
+
+		Run([](void* context, const unsigned workerInd) {
+			Call* call = static_cast<Call*>(context);
+			(call->_object->*call->_method)(workerInd);
+		}, &call);
+	}
+
+	unsigned GetWorkersCount() const { return _workersCount; }
+
+	// hardware threads left over once busyThreadsCount others are running, at least 1 for the calling thread
+	static unsigned GetSpareWorkersCount(unsigned busyThreadsCount);
+
+private:
+	void workerLoop(unsigned workerInd, unsigned seenGeneration);
+
+	unsigned _workersCount = 0;
+	const char* _threadName = nullptr;
+	std::vector<std::thread> _workers;
+
+	std::mutex _taskMutex;
+	std::condition_variable _taskStartedCV;
+	std::condition_variable _taskDoneCV;
+	Task _task = nullptr;
+	void* _context = nullptr;
+	unsigned _taskGeneration = 0;
+	unsigned _workersInTask = 0;
+	bool _stopRequested = false;
+};